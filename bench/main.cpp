@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+
+#include <vt10x/headless.hpp>
+#include <vt10x/pseudo_terminal.hpp>
+#include <vt10x/recording.hpp>
+#include <vt10x/renderer.hpp>
+#include <vt10x/search.hpp>
+#include <vt10x/selection.hpp>
+#include <vt10x/terminal.hpp>
+
+/**
+ * Replays byte streams through the parser and the grid, and optionally the
+ * renderer, the way the render thread sees them: in PTY sized batches with a
+ * frame after each. The built-in corpora are generated from fixed seeds, so a
+ * number is comparable between builds on the same machine.
+ *
+ *   vt10x_bench [--render] [--size=MiB] [--repeat=N] [--history=LINES] [--realtime] [--search=TEXT] [RECORDING...]
+ *
+ * RECORDING is a file of raw child output, e.g. as written by script(1), or
+ * a session recorded by vt10x --record=PATH. A session is replayed a chunk
+ * of output at a time as it was read, sizes included, and with --realtime
+ * at the pace it was recorded rather than as fast as possible.
+ * Each stream is replayed once to warm up before the measured rounds, on
+ * the same grid, whose history keeps LINES (10000 by default): with the
+ * history full by then, the allocations counted are those of a session
+ * that has been running for a while, none unless the stream outgrows what
+ * came before.
+ * Checks of behavior the corpora exercise, one for each bug fixed in it,
+ * run first and stop the benchmark if one fails.
+ * With --search, every stream is also replayed into the scrollback, which
+ * is then searched for TEXT twice: the second search skips the blocks the
+ * first did not match in.
+ */
+
+namespace
+{
+  std::size_t allocations {0}, allocated {0};
+} // namespace
+
+// Out of line, or GCC takes the inlined free() for a mismatch with new.
+
+[[gnu::noinline]] void* operator new(const std::size_t size)
+{
+  ++allocations;
+  allocated += size;
+
+  if (auto* const pointer {std::malloc(size ? size : 1)}; pointer)
+  {
+    return pointer;
+  }
+
+  throw std::bad_alloc {};
+}
+
+[[gnu::noinline]] void operator delete(void* const pointer) noexcept
+{
+  std::free(pointer);
+}
+
+[[gnu::noinline]] void operator delete(void* const pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+namespace corpus
+{
+  using generator = std::function<std::string (std::size_t)>;
+
+  // Interactive shell output: printable lines of varying length.
+  std::string ascii(const std::size_t size)
+  {
+    std::mt19937 random {1};
+    std::uniform_int_distribution<int> length {0, 79}, character {0x20, 0x7E};
+
+    std::string out {};
+
+    while (out.size() < size)
+    {
+      for (auto count {length(random)}; 0 < count; --count)
+      {
+        out += static_cast<char>(character(random));
+      }
+      out += "\r\n";
+    }
+
+    return out;
+  }
+
+  // Mixed scripts: Latin-1, Greek, CJK (wide) and emoji (wide, 4 bytes).
+  std::string utf8(const std::size_t size)
+  {
+    constexpr std::string_view words[] {
+      "caf\xC3\xA9", "\xCE\xB1\xCE\xBB\xCF\x86\xCE\xB1", "\xE6\xBC\xA2\xE5\xAD\x97", "\xE3\x81\x8B\xE3\x81\xAA",
+      "\xF0\x9F\x98\x80", "na\xC3\xAFve", "\xED\x95\x9C\xEA\xB8\x80", "plain",
+    };
+
+    std::mt19937 random {2};
+    std::uniform_int_distribution<std::size_t> word {0, std::size(words) - 1}, count {1, 12};
+
+    std::string out {};
+
+    while (out.size() < size)
+    {
+      for (auto each {count(random)}; 0 < each; --each)
+      {
+        out += words[word(random)];
+        out += ' ';
+      }
+      out += "\r\n";
+    }
+
+    return out;
+  }
+
+  // Colored output such as ls --color or compiler diagnostics: a SGR change
+  // every few characters, 256 colors and true color.
+  std::string sgr(const std::size_t size)
+  {
+    std::mt19937 random {3};
+    std::uniform_int_distribution<int> color {0, 255}, run {1, 6}, kind {0, 3}, character {'a', 'z'};
+
+    std::string out {};
+
+    for (std::size_t column {0}; out.size() < size; )
+    {
+      switch (kind(random))
+      {
+      case 0:
+        out += "\x1B[38;5;" + std::to_string(color(random)) + "m";
+        break;
+
+      case 1:
+        out += "\x1B[48;2;" + std::to_string(color(random)) + ";" + std::to_string(color(random)) + ";" + std::to_string(color(random)) + "m";
+        break;
+
+      case 2:
+        out += "\x1B[1;4m";
+        break;
+
+      default:
+        out += "\x1B[0m";
+        break;
+      }
+
+      for (auto count {run(random)}; 0 < count; --count, ++column)
+      {
+        out += static_cast<char>(character(random));
+      }
+
+      if (72 <= column)
+      {
+        out += "\x1B[0m\r\n";
+        column = 0;
+      }
+    }
+
+    return out;
+  }
+
+  // Full screen programs such as htop or vim: every refresh addresses the
+  // cursor, erases and rewrites parts of most rows.
+  std::string tui(const std::size_t size)
+  {
+    std::mt19937 random {4};
+    std::uniform_int_distribution<int> row {1, 24}, column {1, 60}, length {1, 20}, percent {0, 100};
+
+    std::string out {"\x1B[?1049h\x1B[H\x1B[2J"};
+
+    while (out.size() < size)
+    {
+      out += "\x1B[?25l";
+
+      for (auto line {1}; line <= 24; ++line)
+      {
+        out += "\x1B[" + std::to_string(line) + ";1H\x1B[K";
+        out += "\x1B[32m" + std::to_string(percent(random)) + "%\x1B[0m ";
+        out += std::string(static_cast<std::size_t>(length(random)), '|');
+      }
+
+      for (auto count {0}; count < 8; ++count)
+      {
+        out += "\x1B[" + std::to_string(row(random)) + ";" + std::to_string(column(random)) + "H\x1B[7m";
+        out += std::string(static_cast<std::size_t>(length(random)), '#');
+        out += "\x1B[27m";
+      }
+
+      out += "\x1B[24;1H\x1B[?25h";
+    }
+
+    return out;
+  }
+
+  // A flood such as seq or cat of a log: short lines, every one scrolls.
+  std::string scroll(const std::size_t size)
+  {
+    std::string out {};
+
+    for (std::uint64_t line {0}; out.size() < size; ++line)
+    {
+      out += std::to_string(line) + " INFO request handled in " + std::to_string(line % 997) + "ms\r\n";
+    }
+
+    return out;
+  }
+
+  std::string file(const std::string& path)
+  {
+    std::ifstream stream {path, std::ios::binary};
+
+    if (not stream)
+    {
+      throw std::runtime_error {"cannot read " + path};
+    }
+
+    return {std::istreambuf_iterator<char> {stream}, std::istreambuf_iterator<char> {}};
+  }
+} // namespace corpus
+
+// That of --render.
+constexpr std::string_view font {"Monospace:pixelsize=14:antialias=true:autohint=true"};
+
+// Behavior the corpora depend on, checked before anything is timed.
+namespace check
+{
+  using test = std::function<bool ()>;
+
+  // The text of a row, trailing blanks included.
+  std::u32string row(const vt10x::screen& screen, const std::size_t row)
+  {
+    std::u32string out {};
+
+    for (std::size_t column {0}; column < screen.columns(); ++column)
+    {
+      out += screen(row, column).codepoint;
+    }
+
+    return out;
+  }
+
+  // Resizing keeps a wrapped line whose continuation row was erased.
+  bool reflow_erased_continuation()
+  {
+    vt10x::terminal terminal {4, 10};
+
+    terminal.feed("0123456789ABCDE\r\x1B[K");
+    terminal.resize(4, 20);
+
+    return row(terminal.screen, 0) == U"0123456789          ";
+  }
+
+  // The attribute of a cell, as the renderer reads it.
+  vt10x::attribute rendition(const vt10x::terminal& terminal, const std::size_t row, const std::size_t column)
+  {
+    return terminal.screen.attributes[terminal.screen(row, column).attribute];
+  }
+
+  // Sub-parameters after ':' belong to the parameter before them, and 4:0
+  // turns underlining off as 24 does.
+  bool sgr_subparameters()
+  {
+    vt10x::terminal terminal {4, 10};
+
+    terminal.feed("\x1B[1;31;4:0mA\x1B[0;4:3;32mB\x1B[0;4:0;1mC");
+
+    const auto a {rendition(terminal, 0, 0)}, b {rendition(terminal, 0, 1)}, c {rendition(terminal, 0, 2)};
+
+    return a.style == vt10x::attribute::bold and a.foreground == vt10x::color::indexed(1)
+      and b.style == vt10x::attribute::underline and b.foreground == vt10x::color::indexed(2)
+      and c.style == vt10x::attribute::bold;
+  }
+
+  // CNL and CPL stop at the margins of the scrolling region, as CUD and CUU.
+  bool cnl_cpl_margins()
+  {
+    vt10x::terminal terminal {6, 10};
+
+    terminal.feed("\x1B[2;4r\x1B[3;5H\x1B[9E");
+
+    const auto down {terminal.screen.cursor};
+
+    terminal.feed("\x1B[3;5H\x1B[9F");
+
+    const auto up {terminal.screen.cursor};
+
+    return down.row == 3 and down.column == 0 and up.row == 1 and up.column == 0;
+  }
+
+  // A double width character has no room on a grid of one column.
+  bool wide_on_one_column()
+  {
+    vt10x::terminal terminal {2, 1};
+
+    terminal.feed("\xE4\xB8\xAD");
+
+    return terminal.screen(0, 0).codepoint == U'\uFFFD' and not terminal.screen(0, 0).flags;
+  }
+
+  // Writing over half of a double width character blanks the other half.
+  bool wide_overwritten()
+  {
+    vt10x::terminal terminal {2, 10};
+
+    terminal.feed("\xE4\xB8\xAD\xE4\xB8\xAD\r\x1B[1Cx\x1B[1Cy");
+
+    return row(terminal.screen, 0).substr(0, 4) == U" x y" and not terminal.screen(0, 0).flags and not terminal.screen(0, 3).flags;
+  }
+
+  // DL moves lines up within the screen; none of them reaches the history.
+  bool delete_lines_history()
+  {
+    vt10x::terminal terminal {3, 10};
+
+    terminal.feed("a\r\nb\r\nc\x1B[H\x1B[2M");
+
+    return terminal.history.size() == 0 and row(terminal.screen, 0).front() == U'c';
+  }
+
+  // A drag ends where its button was released, whether or not a motion
+  // reported it; a click selects nothing.
+  bool selection_release()
+  {
+    using vt10x::selection;
+
+    const auto dragged {selection::region::released({0, 2}, {1, 3}, true)};
+    const auto unreported {selection::region::released({1, 3}, {0, 2}, false)};
+
+    return dragged and dragged->first == selection::point {0, 2} and dragged->last == selection::point {1, 3}
+      and unreported and unreported->first == selection::point {0, 2} and unreported->last == selection::point {1, 3}
+      and not selection::region::released({1, 3}, {1, 3}, false);
+  }
+
+  // A full repaint covers the whole image, margins past the last whole cell
+  // included, for back buffers to present.
+  bool full_repaint_box()
+  {
+    vt10x::renderer renderer {font};
+    vt10x::terminal terminal {4, 10};
+
+    const auto width {static_cast<int>(10 * renderer.cell_width) + 3}, height {static_cast<int>(4 * renderer.cell_height) + 3};
+
+    const std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> image {
+      cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height), cairo_surface_destroy
+    };
+
+    renderer.invalidate();
+
+    const auto box {renderer.render(image.get(), terminal.screen)};
+
+    return box.x == 0 and box.y == 0 and box.width == width and box.height == height;
+  }
+} // namespace check
+
+struct result
+{
+  double seconds;
+
+  std::size_t bytes, allocations, allocated;
+};
+
+result replay(vt10x::headless& backend, const std::string_view stream, const std::size_t repeat)
+{
+  const auto count {allocations}, size {allocated};
+
+  const auto started {std::chrono::steady_clock::now()};
+
+  for (std::size_t round {0}; round < repeat; ++round)
+  {
+    for (std::size_t offset {0}; offset < stream.size(); offset += vt10x::pseudo_terminal::batch_size)
+    {
+      backend(stream.substr(offset, vt10x::pseudo_terminal::batch_size));
+      backend.input.clear();
+      backend.render();
+    }
+  }
+
+  const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - started};
+
+  return {elapsed.count(), stream.size() * repeat, allocations - count, allocated - size};
+}
+
+// Like the above, for a recorded session.
+result replay(vt10x::headless& backend, const vt10x::recording& session, const std::size_t repeat, const bool realtime)
+{
+  const auto count {allocations}, size {allocated};
+
+  const auto started {std::chrono::steady_clock::now()};
+
+  std::size_t bytes {0};
+
+  for (std::size_t round {0}; round < repeat; ++round)
+  {
+    const auto begun {std::chrono::steady_clock::now()};
+
+    for (std::size_t index {0}; index < session.size(); ++index)
+    {
+      const auto event {session[index]};
+
+      if (realtime)
+      {
+        std::this_thread::sleep_until(begun + event.time);
+      }
+
+      if (event.kind == vt10x::recording_format::output)
+      {
+        backend(event.data);
+        backend.input.clear();
+        backend.render();
+
+        bytes += event.data.size();
+      }
+      else if (event.kind == vt10x::recording_format::resize)
+      {
+        const auto [rows, columns] {event.size()};
+        backend.resize(rows, columns);
+      }
+    }
+  }
+
+  const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - started};
+
+  return {elapsed.count(), bytes, allocations - count, allocated - size};
+}
+
+struct found
+{
+  double seconds;
+
+  std::size_t matches;
+};
+
+found find(vt10x::search& search, const std::string& pattern)
+{
+  const auto started {std::chrono::steady_clock::now()};
+
+  std::size_t matches {0};
+
+  search.find(pattern);
+
+  for (pollfd ready {search.descriptor(), POLLIN, 0}; ; poll(&ready, 1, -1))
+  {
+    if (search.consume([&](const auto& batch) { matches += batch.size(); }))
+    {
+      break;
+    }
+  }
+
+  const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - started};
+
+  return {elapsed.count(), matches};
+}
+
+int main(const int argc, char const* const* const argv)
+{
+  const std::vector<std::string> args {argv + 1, argv + argc};
+
+  auto render {false}, realtime {false};
+
+  std::size_t size {8}, repeat {4};
+
+  vt10x::scrollback::limits history {};
+  history.lines = 10000;
+
+  std::vector<std::pair<std::string, std::string>> streams {};
+
+  std::vector<std::string> recordings {};
+
+  std::vector<std::pair<std::string, std::unique_ptr<const vt10x::recording>>> sessions {};
+
+  std::string pattern {};
+
+  for (const auto& each : args)
+  {
+    if (each == "--render")
+    {
+      render = true;
+    }
+    else if (each.compare(0, 7, "--size=") == 0)
+    {
+      size = std::stoul(each.substr(7));
+    }
+    else if (each.compare(0, 9, "--repeat=") == 0)
+    {
+      repeat = std::max(1ul, std::stoul(each.substr(9)));
+    }
+    else if (each == "--realtime")
+    {
+      realtime = true;
+    }
+    else if (each.compare(0, 10, "--history=") == 0)
+    {
+      history.lines = std::stoul(each.substr(10));
+    }
+    else if (each.compare(0, 9, "--search=") == 0)
+    {
+      pattern = each.substr(9);
+    }
+    else
+    {
+      recordings.push_back(each);
+    }
+  }
+
+  const std::pair<const char*, corpus::generator> generated[] {
+    {"ascii", corpus::ascii}, {"utf8", corpus::utf8}, {"sgr", corpus::sgr}, {"tui", corpus::tui}, {"scroll", corpus::scroll},
+  };
+
+  for (const auto& [name, generate] : generated)
+  {
+    streams.emplace_back(name, generate(size << 20));
+  }
+
+  for (const auto& path : recordings)
+  {
+    if (vt10x::recording::is(path))
+    {
+      sessions.emplace_back(path, std::make_unique<const vt10x::recording>(path));
+    }
+    else
+    {
+      streams.emplace_back(path, corpus::file(path));
+    }
+  }
+
+  const std::pair<const char*, check::test> checks[] {
+    {"reflow of an erased continuation row", check::reflow_erased_continuation},
+    {"SGR sub-parameters", check::sgr_subparameters},
+    {"CNL and CPL within the margins", check::cnl_cpl_margins},
+    {"double width character on one column", check::wide_on_one_column},
+    {"double width character written over", check::wide_overwritten},
+    {"DL kept out of the history", check::delete_lines_history},
+    {"selection ended at the release", check::selection_release},
+    {"box of a full repaint", check::full_repaint_box},
+  };
+
+  for (const auto& [name, passes] : checks)
+  {
+    if (not passes())
+    {
+      std::fprintf(stderr, "check failed: %s\n", name);
+      return 1;
+    }
+  }
+
+  std::printf("%-16s %10s %10s %12s %14s\n", "corpus", "MB/s", "ns/byte", "allocations", "alloc bytes");
+
+  const auto print = [](const std::string& name, const result& measured)
+  {
+    std::printf(
+      "%-16s %10.1f %10.2f %12zu %14zu\n",
+      name.c_str(),
+      measured.bytes / measured.seconds / 1e6,
+      measured.seconds * 1e9 / measured.bytes,
+      measured.allocations,
+      measured.allocated
+    );
+  };
+
+  const auto make = [&]
+  {
+    auto backend {render ? std::make_unique<vt10x::headless>(font) : std::make_unique<vt10x::headless>()};
+
+    backend->terminal.history.configure(history);
+
+    return backend;
+  };
+
+  for (const auto& [name, stream] : streams)
+  {
+    const auto backend {make()};
+
+    replay(*backend, stream, 1); // warm up caches, and fill the history
+
+    print(name, replay(*backend, stream, repeat));
+  }
+
+  for (const auto& [name, session] : sessions)
+  {
+    const auto backend {make()};
+
+    replay(*backend, *session, 1, false);
+
+    print(name, replay(*backend, *session, repeat, realtime));
+  }
+
+  if (pattern.empty())
+  {
+    return 0;
+  }
+
+  std::printf("\n%-16s %10s %10s %10s %12s\n", "corpus", "lines", "matches", "first ms", "again ms");
+
+  // Searches the history of what feed(backend) left.
+  const auto searched = [&](const std::string& name, const auto& feed)
+  {
+    vt10x::headless backend {};
+
+    feed(backend);
+
+    vt10x::search search {backend.terminal.history};
+
+    const auto first {find(search, pattern)}, again {find(search, pattern)};
+
+    std::printf(
+      "%-16s %10zu %10zu %10.2f %12.2f\n",
+      name.c_str(), backend.terminal.history.size(), first.matches, first.seconds * 1e3, again.seconds * 1e3
+    );
+  };
+
+  for (const auto& each : streams)
+  {
+    searched(each.first, [&](vt10x::headless& backend)
+    {
+      const std::string_view stream {each.second};
+
+      for (std::size_t offset {0}; offset < stream.size(); offset += vt10x::pseudo_terminal::batch_size)
+      {
+        backend(stream.substr(offset, vt10x::pseudo_terminal::batch_size));
+      }
+    });
+  }
+
+  for (const auto& each : sessions)
+  {
+    searched(each.first, [&](vt10x::headless& backend)
+    {
+      replay(backend, *each.second, 1, false);
+    });
+  }
+
+  return 0;
+}
@@ -0,0 +1,161 @@
+#ifndef INCLUDED_VT10X_ATLAS_HPP
+#define INCLUDED_VT10X_ATLAS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <cairo/cairo.h>
+
+namespace vt10x
+{
+  /**
+   * Glyphs rasterized once into slots of a single A8 image. The image holds
+   * coverage only, so one glyph serves every foreground and background pair:
+   * the renderer masks a solid source with it. When every slot is taken, the
+   * least recently used glyph is evicted.
+   */
+  class glyph_atlas
+  {
+    static constexpr std::size_t columns {32};
+
+    const int slot_width, slot_height;
+
+    const std::uint16_t capacity;
+
+    const std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> image;
+
+    const std::unique_ptr<cairo_t, decltype(&cairo_destroy)> context;
+
+    std::unordered_map<std::uint32_t, std::uint16_t> slots;
+
+    std::vector<std::uint32_t> keys;
+
+    // Doubly linked recency list through slot indices, most recent first. The
+    // entry at index capacity is the sentinel.
+    std::vector<std::uint16_t> prev, next;
+
+  public:
+    struct position
+    {
+      double x, y;
+    };
+
+    std::size_t hits {0}, misses {0}, evictions {0};
+
+    // Style bits that change the shape of a glyph; colors do not.
+    static constexpr std::uint32_t key(const char32_t codepoint, const std::uint16_t style) noexcept
+    {
+      return static_cast<std::uint32_t>(codepoint) | static_cast<std::uint32_t>(style & 0b101) << 21;
+    }
+
+    explicit glyph_atlas(const int slot_width, const int slot_height, const std::uint16_t capacity = 1024)
+      : slot_width {slot_width}
+      , slot_height {slot_height}
+      , capacity {capacity}
+      , image {
+          cairo_image_surface_create(
+            CAIRO_FORMAT_A8, slot_width * columns, slot_height * ((capacity + columns - 1) / columns)
+          ),
+          cairo_surface_destroy
+        }
+      , context {cairo_create(image.get()), cairo_destroy}
+      , prev (capacity + 1u, capacity)
+      , next (capacity + 1u, capacity)
+    {
+      if (cairo_surface_status(image.get()))
+      {
+        throw std::runtime_error {"cairo_image_surface_create"};
+      }
+
+      slots.reserve(capacity);
+      keys.reserve(capacity);
+    }
+
+    cairo_surface_t* surface() const noexcept
+    {
+      return image.get();
+    }
+
+    /**
+     * Returns where the glyph for key is in the atlas, calling
+     * rasterize(context, x, y) to draw it into a cleared slot with its top
+     * left corner at (x, y) if it is not there yet.
+     */
+    template <typename F>
+    position find(const std::uint32_t key, F&& rasterize)
+    {
+      if (const auto iter {slots.find(key)}; iter != slots.end())
+      {
+        ++hits;
+        touch(iter->second);
+        return locate(iter->second);
+      }
+
+      ++misses;
+
+      std::uint16_t slot {0};
+
+      if (keys.size() < capacity)
+      {
+        slot = static_cast<std::uint16_t>(keys.size());
+        keys.push_back(key);
+      }
+      else
+      {
+        slot = prev[capacity];
+        slots.erase(keys[slot]);
+        keys[slot] = key;
+        ++evictions;
+      }
+
+      slots.emplace(key, slot);
+      touch(slot);
+
+      const auto at {locate(slot)};
+
+      cairo_save(context.get());
+      cairo_rectangle(context.get(), at.x, at.y, slot_width, slot_height);
+      cairo_clip(context.get());
+      cairo_set_operator(context.get(), CAIRO_OPERATOR_CLEAR);
+      cairo_paint(context.get());
+      cairo_set_operator(context.get(), CAIRO_OPERATOR_OVER);
+      cairo_set_source_rgba(context.get(), 0, 0, 0, 1);
+      rasterize(context.get(), at.x, at.y);
+      cairo_restore(context.get());
+
+      return at;
+    }
+
+  private:
+    position locate(const std::uint16_t slot) const noexcept
+    {
+      return {static_cast<double>(slot % columns * slot_width), static_cast<double>(slot / columns * slot_height)};
+    }
+
+    // Moves slot to the front of the recency list, linking it in if new.
+    void touch(const std::uint16_t slot) noexcept
+    {
+      if (next[capacity] == slot)
+      {
+        return;
+      }
+
+      if (prev[slot] != capacity) // linked, but not at the front
+      {
+        next[prev[slot]] = next[slot];
+        prev[next[slot]] = prev[slot];
+      }
+
+      prev[slot] = capacity;
+      next[slot] = next[capacity];
+      prev[next[capacity]] = slot;
+      next[capacity] = slot;
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_ATLAS_HPP
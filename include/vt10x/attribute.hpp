@@ -0,0 +1,177 @@
+#ifndef INCLUDED_VT10X_ATTRIBUTE_HPP
+#define INCLUDED_VT10X_ATTRIBUTE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vt10x
+{
+  /**
+   * Color of SGR 30-49 and 90-107, tagged in the most significant byte as the
+   * default color, an index of the 256-color palette or a 24-bit RGB value.
+   */
+  struct color
+  {
+    static constexpr std::uint32_t default_ {0},
+                                   palette  {1u << 24},
+                                   rgb      {2u << 24};
+
+    static constexpr auto indexed(const std::uint8_t index) noexcept
+    {
+      return palette | index;
+    }
+
+    static constexpr auto direct(const std::uint8_t r, const std::uint8_t g, const std::uint8_t b) noexcept
+    {
+      return rgb | static_cast<std::uint32_t>(r) << 16 | static_cast<std::uint32_t>(g) << 8 | b;
+    }
+
+    static constexpr auto kind(const std::uint32_t value) noexcept
+    {
+      return value & 0xFF000000;
+    }
+  };
+
+  // Select Graphic Rendition.
+  struct attribute
+  {
+    std::uint32_t foreground, background;
+
+    std::uint16_t style;
+
+    enum : std::uint16_t
+    {
+      bold      = 1 << 0,
+      faint     = 1 << 1,
+      italic    = 1 << 2,
+      underline = 1 << 3,
+      blink     = 1 << 4,
+      inverse   = 1 << 5,
+      invisible = 1 << 6,
+      strike    = 1 << 7,
+    };
+
+    constexpr bool operator==(const attribute& rhs) const noexcept
+    {
+      return foreground == rhs.foreground and background == rhs.background and style == rhs.style;
+    }
+
+    constexpr bool operator!=(const attribute& rhs) const noexcept
+    {
+      return not (*this == rhs);
+    }
+  };
+
+  /**
+   * Attributes referred by cell::attribute. The index 0 is the default one.
+   * Interning finds an attribute through a hash index of its own, open
+   * addressed and at most half full, so that colorized output costs the same
+   * whatever number of attributes it used before.
+   *
+   * Entries are never removed; the owner of the cells that index a table
+   * replaces it by one of only the attributes still in use instead, which
+   * comes with the next generation number.
+   */
+  class attribute_table
+  {
+    std::vector<attribute> entries {attribute {color::default_, color::default_, 0}};
+
+    std::vector<std::uint32_t> slots {}; // index of an entry plus 1, 0 if free
+
+    std::uint32_t generation_;
+
+    static constexpr std::size_t hash(const attribute& value) noexcept
+    {
+      auto mixed {(std::uint64_t {value.foreground} << 32 | value.background) * 0x9E3779B97F4A7C15u};
+      mixed ^= (mixed >> 29) + value.style * 0xBF58476D1CE4E5B9u;
+      return static_cast<std::size_t>(mixed ^ mixed >> 32);
+    }
+
+    // Where value is, or the free slot where it would go.
+    std::size_t find(const attribute& value) const noexcept
+    {
+      const auto mask {slots.size() - 1};
+
+      auto slot {hash(value) & mask};
+
+      for (; slots[slot] and entries[slots[slot] - 1] != value; slot = (slot + 1) & mask);
+
+      return slot;
+    }
+
+    void rehash(const std::size_t size)
+    {
+      slots.assign(size, 0);
+
+      for (std::size_t index {0}; index < entries.size(); ++index)
+      {
+        slots[find(entries[index])] = static_cast<std::uint32_t>(index + 1);
+      }
+    }
+
+  public:
+    static constexpr std::size_t capacity {UINT16_MAX + 1};
+
+    explicit attribute_table(const std::uint32_t generation = 0)
+      : generation_ {generation}
+    {
+      rehash(64);
+    }
+
+    decltype(auto) operator[](const std::uint16_t index) const noexcept
+    {
+      return entries[index];
+    }
+
+    auto size() const noexcept
+    {
+      return entries.size();
+    }
+
+    auto full() const noexcept
+    {
+      return capacity <= entries.size();
+    }
+
+    auto generation() const noexcept
+    {
+      return generation_;
+    }
+
+    // Forgets every attribute but the default one, keeping the memory.
+    void clear(const std::uint32_t generation)
+    {
+      entries.assign(1, attribute {color::default_, color::default_, 0});
+      rehash(std::max<std::size_t>(slots.size(), 64));
+      generation_ = generation;
+    }
+
+    // The index of value, added if it is new; 0 if it is and the table is full.
+    std::uint16_t intern(const attribute& value)
+    {
+      if (const auto found {slots[find(value)]}; found)
+      {
+        return static_cast<std::uint16_t>(found - 1);
+      }
+
+      if (full())
+      {
+        return 0;
+      }
+
+      if (slots.size() < 2 * (entries.size() + 1))
+      {
+        rehash(2 * slots.size());
+      }
+
+      entries.push_back(value);
+      slots[find(value)] = static_cast<std::uint32_t>(entries.size());
+
+      return static_cast<std::uint16_t>(entries.size() - 1);
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_ATTRIBUTE_HPP
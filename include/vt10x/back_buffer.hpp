@@ -0,0 +1,288 @@
+#ifndef INCLUDED_VT10X_BACK_BUFFER_HPP
+#define INCLUDED_VT10X_BACK_BUFFER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <cairo/cairo.h>
+#include <xcb/shm.h>
+#include <xcb/xcb.h>
+
+namespace vt10x
+{
+  /**
+   * Client side image the renderer draws into, presented to a window once per
+   * frame. With the MIT-SHM extension the image lives in a segment shared with
+   * the server and presenting is a single ShmPutImage of the damaged box;
+   * otherwise its rows are sent with PutImage. Either way no draw operation
+   * becomes protocol, and the window never shows a half drawn frame.
+   */
+  class back_buffer
+  {
+    xcb_connection_t* const connection;
+
+    const xcb_window_t window;
+
+    const xcb_gcontext_t context;
+
+    const std::uint8_t depth;
+
+    int width_ {0}, height_ {0};
+
+    // Segment of the current image, or 0 (never a valid XID) without MIT-SHM.
+    xcb_shm_seg_t segment {0};
+
+    void* shared {nullptr};
+
+    std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> image {nullptr, cairo_surface_destroy};
+
+    bool shareable;
+
+    // ShmPutImage reads the segment asynchronously, so it must not be drawn
+    // into until the server reports completion.
+    bool busy_ {false};
+
+  public:
+    explicit back_buffer(xcb_connection_t* const connection, const xcb_window_t window, const std::uint8_t depth, const bool shm = true)
+      : connection {connection}
+      , window {window}
+      , context {xcb_generate_id(connection)}
+      , depth {depth}
+      , shareable {shm and supports_shm(connection)}
+    {
+      if (depth != 24 and depth != 32)
+      {
+        throw std::runtime_error {"back buffer requires a depth of 24 or 32"};
+      }
+
+      // cairo's RGB24 and ARGB32 are native endian 32 bit pixels.
+      const auto* const setup {xcb_get_setup(connection)};
+
+      const auto* format {xcb_setup_pixmap_formats(setup)};
+      const auto* const last {format + xcb_setup_pixmap_formats_length(setup)};
+
+      for (; format != last and format->depth != depth; ++format);
+
+      if (format == last or format->bits_per_pixel != 32 or setup->image_byte_order != native_byte_order())
+      {
+        throw std::runtime_error {"back buffer requires native endian 32 bits per pixel"};
+      }
+
+      xcb_create_gc(connection, context, window, 0, nullptr);
+    }
+
+    back_buffer(const back_buffer&) = delete;
+    back_buffer& operator=(const back_buffer&) = delete;
+
+    ~back_buffer()
+    {
+      release();
+      xcb_free_gc(connection, context);
+    }
+
+    cairo_surface_t* surface() const noexcept
+    {
+      return image.get();
+    }
+
+    auto width() const noexcept
+    {
+      return width_;
+    }
+
+    auto height() const noexcept
+    {
+      return height_;
+    }
+
+    auto busy() const noexcept
+    {
+      return busy_;
+    }
+
+    auto shared_memory() const noexcept
+    {
+      return segment != 0;
+    }
+
+    // Reallocates the image if the size changed, and returns whether it did;
+    // the contents of a new image are undefined until redrawn.
+    bool resize(const int width, const int height)
+    {
+      if (width == width_ and height == height_ and image)
+      {
+        return false;
+      }
+
+      release();
+
+      width_ = std::max(width, 1);
+      height_ = std::max(height, 1);
+
+      const auto format {depth == 32 ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24};
+      const auto stride {cairo_format_stride_for_width(format, width_)};
+
+      if (shareable and attach(static_cast<std::size_t>(stride) * height_))
+      {
+        image.reset(cairo_image_surface_create_for_data(static_cast<unsigned char*>(shared), format, width_, height_, stride));
+      }
+      else
+      {
+        image.reset(cairo_image_surface_create(format, width_, height_));
+      }
+
+      if (cairo_surface_status(image.get()))
+      {
+        throw std::runtime_error {"cairo_image_surface_create"};
+      }
+
+      return true;
+    }
+
+    // Copies a box of the image to the same place in the window.
+    void present(const double x, const double y, const double width, const double height)
+    {
+      // Clamped before the casts, which are undefined out of range.
+      const auto left {static_cast<int>(std::clamp(x, 0.0, static_cast<double>(width_)))};
+      const auto top {static_cast<int>(std::clamp(y, 0.0, static_cast<double>(height_)))};
+      const auto right {static_cast<int>(std::clamp(x + width + 0.5, static_cast<double>(left), static_cast<double>(width_)))};
+      const auto bottom {static_cast<int>(std::clamp(y + height + 0.5, static_cast<double>(top), static_cast<double>(height_)))};
+
+      if (left == right or top == bottom)
+      {
+        return;
+      }
+
+      cairo_surface_flush(image.get());
+
+      if (segment)
+      {
+        xcb_shm_put_image(
+          connection, window, context,
+          width_, height_, left, top, right - left, bottom - top, left, top,
+          depth, XCB_IMAGE_FORMAT_Z_PIXMAP, true, segment, 0
+        );
+
+        busy_ = true;
+      }
+      else
+      {
+        // Whole rows are contiguous in the image, so they are sent as is, in
+        // as many requests as the maximum request length calls for.
+        const auto stride {cairo_image_surface_get_stride(image.get())};
+        const auto* const data {cairo_image_surface_get_data(image.get())};
+
+        const auto limit {(xcb_get_maximum_request_length(connection) * 4 - sizeof(xcb_put_image_request_t)) / stride};
+        const auto rows_per_request {static_cast<int>(std::max<std::size_t>(limit, 1))};
+
+        for (auto row {top}; row < bottom; row += rows_per_request)
+        {
+          const auto rows {std::min(rows_per_request, bottom - row)};
+
+          xcb_put_image(
+            connection, XCB_IMAGE_FORMAT_Z_PIXMAP, window, context,
+            width_, rows, 0, row, 0, depth, rows * stride, data + row * stride
+          );
+        }
+      }
+    }
+
+    // Returns true if event is the completion of a presentation of ours.
+    bool complete(const xcb_generic_event_t* const event) noexcept
+    {
+      const auto* const extension {xcb_get_extension_data(connection, &xcb_shm_id)};
+
+      if (not segment or not extension or (event->response_type & ~0x80) != extension->first_event + XCB_SHM_COMPLETION)
+      {
+        return false;
+      }
+
+      if (reinterpret_cast<const xcb_shm_completion_event_t*>(event)->shmseg == segment)
+      {
+        busy_ = false;
+      }
+
+      return true;
+    }
+
+  private:
+    static bool supports_shm(xcb_connection_t* const connection)
+    {
+      const auto* const extension {xcb_get_extension_data(connection, &xcb_shm_id)};
+      return extension and extension->present;
+    }
+
+    static constexpr std::uint8_t native_byte_order() noexcept
+    {
+      #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      return XCB_IMAGE_ORDER_LSB_FIRST;
+      #else
+      return XCB_IMAGE_ORDER_MSB_FIRST;
+      #endif
+    }
+
+    // Creates and attaches a segment, false if the server cannot share memory
+    // with us (e.g. it is remote).
+    bool attach(const std::size_t size)
+    {
+      const auto id {shmget(IPC_PRIVATE, size, IPC_CREAT | 0600)};
+
+      if (id < 0)
+      {
+        return false;
+      }
+
+      shared = shmat(id, nullptr, 0);
+
+      if (shared == reinterpret_cast<void*>(-1))
+      {
+        shared = nullptr;
+        shmctl(id, IPC_RMID, nullptr);
+        return false;
+      }
+
+      segment = xcb_generate_id(connection);
+
+      auto* const error {xcb_request_check(connection, xcb_shm_attach_checked(connection, segment, id, false))};
+
+      // Once the server has attached it, the segment only has to live until
+      // both sides detach.
+      shmctl(id, IPC_RMID, nullptr);
+
+      if (error)
+      {
+        std::free(error);
+        shmdt(shared);
+        shared = nullptr;
+        segment = 0;
+        shareable = false; // not worth a round trip on every resize
+        return false;
+      }
+
+      return true;
+    }
+
+    void release() noexcept
+    {
+      image.reset();
+
+      if (segment)
+      {
+        xcb_shm_detach(connection, segment);
+        shmdt(shared);
+        shared = nullptr;
+        segment = 0;
+      }
+
+      busy_ = false;
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_BACK_BUFFER_HPP
@@ -0,0 +1,32 @@
+#ifndef INCLUDED_VT10X_CELL_HPP
+#define INCLUDED_VT10X_CELL_HPP
+
+#include <cstdint>
+
+namespace vt10x
+{
+  /**
+   * One character cell. The attribute is an index into the attribute table of
+   * the screen, so that the whole grid stays at 8 bytes per cell and a row of
+   * 80 columns fits in ten cache lines.
+   */
+  struct cell
+  {
+    char32_t codepoint;
+
+    std::uint16_t attribute;
+
+    std::uint16_t flags;
+
+    enum : std::uint16_t
+    {
+      wide        = 1 << 0, // first half of a double width character
+      wide_spacer = 1 << 1, // second half of a double width character
+      wrapped     = 1 << 2, // last cell of a line continued by autowrap
+    };
+  };
+
+  static_assert(sizeof(cell) == 8);
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_CELL_HPP
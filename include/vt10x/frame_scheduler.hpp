@@ -0,0 +1,131 @@
+#ifndef INCLUDED_VT10X_FRAME_SCHEDULER_HPP
+#define INCLUDED_VT10X_FRAME_SCHEDULER_HPP
+
+#include <algorithm>
+#include <chrono>
+
+namespace vt10x
+{
+  /**
+   * Decides when the grid is drawn, independently of when it is written to.
+   * Frames are at least one interval apart, so under a flood the time goes to
+   * parsing; but the first change after an idle gap longer than the interval
+   * is drawn at once, so echo of typed characters is never held back.
+   *
+   * While the application draws a frame of its own (synchronized output,
+   * mode 2026) nothing is due, so its half drawn states are never shown;
+   * but only for hold_limit, so that one which never ends the frame, e.g.
+   * because it crashed, cannot freeze the window.
+   *
+   * Nothing is due either while the window cannot be seen, and frames are
+   * at most background_rate per second while it is out of focus: a window
+   * tailing a log in the background costs little more than the parsing.
+   */
+  class frame_scheduler
+  {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds hold_limit {150};
+
+    static constexpr unsigned background_rate {10};
+
+  private:
+    clock::duration interval;
+
+    clock::time_point last {}, held {};
+
+    bool pending {false}, holding {false}, suspended {false}, throttled {false};
+
+  public:
+    explicit frame_scheduler(const unsigned rate = 60)
+      : interval {period(rate)}
+    {}
+
+    // Frames per second at most, 0 for no cap.
+    void cap(const unsigned rate) noexcept
+    {
+      interval = period(rate);
+    }
+
+    // The window can be seen, or not.
+    void suspend(const bool value) noexcept
+    {
+      suspended = value;
+    }
+
+    // The window has the focus, or not.
+    void throttle(const bool value) noexcept
+    {
+      throttled = value;
+    }
+
+    // Something may have changed on screen.
+    void request() noexcept
+    {
+      pending = true;
+    }
+
+    auto requested() const noexcept
+    {
+      return pending;
+    }
+
+    // The application began or ended a frame of its own.
+    void hold(const bool value, const clock::time_point now) noexcept
+    {
+      if (value and not holding)
+      {
+        held = now;
+      }
+
+      holding = value;
+    }
+
+    auto due(const clock::time_point now) const noexcept
+    {
+      return pending and not suspended and next() <= now;
+    }
+
+    void presented(const clock::time_point now) noexcept
+    {
+      pending = false;
+      last = now;
+    }
+
+    // Milliseconds until the next frame is due, -1 if none is pending or the
+    // window is suspended, as the timeout of the reactor.
+    int timeout(const clock::time_point now) const noexcept
+    {
+      if (not pending or suspended)
+      {
+        return -1;
+      }
+      else if (next() <= now)
+      {
+        return 0;
+      }
+      else
+      {
+        // Rounded up, so that the wakeup never comes before the frame is due.
+        return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(next() - now).count());
+      }
+    }
+
+  private:
+    // When a pending frame is due.
+    clock::time_point next() const noexcept
+    {
+      const auto spacing {throttled ? std::max(interval, period(background_rate)) : interval};
+
+      return holding ? std::max(last + spacing, held + hold_limit) : last + spacing;
+    }
+
+    static clock::duration period(const unsigned rate) noexcept
+    {
+      return rate ? std::chrono::duration_cast<clock::duration>(std::chrono::seconds {1}) / rate : clock::duration::zero();
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_FRAME_SCHEDULER_HPP
@@ -0,0 +1,495 @@
+#ifndef INCLUDED_VT10X_GLES_RENDERER_HPP
+#define INCLUDED_VT10X_GLES_RENDERER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef> // offsetof
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <cairo/cairo.h>
+#include <xcb/xcb.h>
+
+#include <vt10x/renderer.hpp>
+#include <vt10x/screen.hpp>
+
+namespace vt10x
+{
+  /**
+   * An OpenGL ES 3 context drawing to an X window, through EGL on the xcb
+   * connection of the window. Every window has a context of its own, so the
+   * one that draws makes it current first.
+   */
+  class egl_window
+  {
+    EGLDisplay display;
+
+    EGLConfig config {nullptr};
+
+    EGLContext context {EGL_NO_CONTEXT};
+
+    EGLSurface surface {EGL_NO_SURFACE};
+
+  public:
+    explicit egl_window(xcb_connection_t* const connection, const int screen, xcb_window_t window)
+      : display {eglGetPlatformDisplay(EGL_PLATFORM_XCB_EXT, connection, std::array<EGLAttrib, 3> {EGL_PLATFORM_XCB_SCREEN_EXT, screen, EGL_NONE}.data())}
+    {
+      if (display == EGL_NO_DISPLAY or not eglInitialize(display, nullptr, nullptr) or not eglBindAPI(EGL_OPENGL_ES_API))
+      {
+        throw std::runtime_error {"eglInitialize"};
+      }
+
+      const EGLint attributes[] {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+      };
+
+      if (EGLint count {0}; not eglChooseConfig(display, attributes, &config, 1, &count) or count < 1)
+      {
+        throw std::runtime_error {"there is no EGL config for OpenGL ES 3"};
+      }
+
+      const EGLint version[] {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE};
+
+      if (context = eglCreateContext(display, config, EGL_NO_CONTEXT, version); context == EGL_NO_CONTEXT)
+      {
+        throw std::runtime_error {"eglCreateContext"};
+      }
+
+      // Of the XCB platform, the native window is a pointer to the XID.
+      if (surface = eglCreatePlatformWindowSurface(display, config, &window, nullptr); surface == EGL_NO_SURFACE)
+      {
+        eglDestroyContext(display, context);
+        throw std::runtime_error {"eglCreatePlatformWindowSurface"};
+      }
+
+      current();
+
+      // Frames are paced by the frame scheduler, not by waiting for vblank.
+      eglSwapInterval(display, 0);
+    }
+
+    egl_window(const egl_window&) = delete;
+    egl_window& operator=(const egl_window&) = delete;
+
+    // The display is that of the connection, which other windows share, so
+    // it is not terminated.
+    ~egl_window()
+    {
+      eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+      eglDestroySurface(display, surface);
+      eglDestroyContext(display, context);
+    }
+
+    void current() const
+    {
+      if (not eglMakeCurrent(display, surface, surface, context))
+      {
+        throw std::runtime_error {"eglMakeCurrent"};
+      }
+    }
+
+    void present() const noexcept
+    {
+      eglSwapBuffers(display, surface);
+    }
+  };
+
+  /**
+   * Draws a screen with OpenGL ES 3, the whole grid in one instanced draw of
+   * a quad per cell. The attributes of the instances (cell, glyph, colors)
+   * live in a buffer of which only the rows damaged since the last frame are
+   * rewritten, so that a frame costs the GPU a fill of the window and the CPU
+   * what changed. Glyphs are those of a cairo renderer, rasterized into its
+   * atlas, which is uploaded as a texture whenever it gained some; colors
+   * and the selection are that renderer's too.
+   *
+   * Requires the context of the target to be current.
+   */
+  class gles_renderer
+  {
+    struct instance
+    {
+      std::uint16_t column, row;
+
+      std::uint16_t x, y; // of the glyph in the atlas
+
+      std::uint8_t fore[4], back[4]; // R, G, B and unused
+
+      std::uint8_t width, lines, marks, glyph;
+    };
+
+    static_assert(sizeof(instance) == 20);
+
+    enum : std::uint8_t
+    {
+      underline = 1 << 0, strike = 1 << 1, // lines
+      selected = 1 << 0, cursor = 1 << 1, // marks
+    };
+
+    static constexpr const char* vertex_shader {R"(#version 300 es
+      layout(location = 0) in uvec2 cell;
+      layout(location = 1) in uvec2 glyph;
+      layout(location = 2) in vec4 fore;
+      layout(location = 3) in vec4 back;
+      layout(location = 4) in uvec4 traits;
+
+      uniform vec2 cell_size, viewport, atlas_size;
+
+      out vec2 texel, local;
+      flat out vec3 foreground, background;
+      flat out uvec4 shape;
+
+      void main()
+      {
+        vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+
+        local = corner * vec2(float(traits.x), 1.0) * cell_size;
+        texel = (vec2(glyph) + local) / atlas_size;
+
+        vec2 pixel = vec2(cell) * cell_size + local;
+
+        gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, 0.0, 1.0);
+
+        foreground = fore.rgb;
+        background = back.rgb;
+        shape = traits;
+      }
+    )"};
+
+    static constexpr const char* fragment_shader {R"(#version 300 es
+      precision highp float;
+
+      uniform sampler2D atlas;
+      uniform float ascent;
+      uniform vec3 overlay;
+
+      in vec2 texel, local;
+      flat in vec3 foreground, background;
+      flat in uvec4 shape; // width, lines, marks, glyph
+
+      out vec4 color;
+
+      void main()
+      {
+        float coverage = shape.w != 0u ? texture(atlas, texel).r : 0.0;
+        float y = floor(local.y);
+
+        if (((shape.y & 1u) != 0u && y == ascent + 1.0) || ((shape.y & 2u) != 0u && y == floor(ascent / 2.0 + 0.5)))
+        {
+          coverage = 1.0;
+        }
+
+        vec3 shade = mix(background, foreground, coverage);
+
+        if ((shape.z & 1u) != 0u)
+        {
+          shade = mix(shade, overlay, 0.3);
+        }
+
+        if ((shape.z & 2u) != 0u)
+        {
+          shade = mix(shade, overlay, 0.5);
+        }
+
+        color = vec4(shade, 1.0);
+      }
+    )"};
+
+    renderer& glyphs;
+
+    GLuint program {0}, vertices {0}, buffer {0}, texture {0};
+
+    GLint viewport {-1};
+
+    int width {1}, height {1};
+
+    std::vector<instance> instances {};
+
+    std::size_t rows {0}, columns {0};
+
+    vt10x::cursor drawn {0, 0, 0, false, false}; // where the cursor was drawn last
+
+    std::size_t uploaded {0}, evicted {0}; // glyph misses and evictions as of the last upload
+
+    bool resized {true};
+
+  public:
+    explicit gles_renderer(renderer& glyphs)
+      : glyphs {glyphs}
+    {
+      const auto vertex {compile(GL_VERTEX_SHADER, vertex_shader)};
+      const auto fragment {compile(GL_FRAGMENT_SHADER, fragment_shader)};
+
+      program = glCreateProgram();
+      glAttachShader(program, vertex);
+      glAttachShader(program, fragment);
+      glLinkProgram(program);
+      glDeleteShader(vertex);
+      glDeleteShader(fragment);
+
+      if (GLint linked {GL_FALSE}; glGetProgramiv(program, GL_LINK_STATUS, &linked), linked != GL_TRUE)
+      {
+        throw std::runtime_error {"glLinkProgram: " + log(program, glGetProgramiv, glGetProgramInfoLog)};
+      }
+
+      glGenVertexArrays(1, &vertices);
+      glBindVertexArray(vertices);
+
+      glGenBuffers(1, &buffer);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+      glVertexAttribIPointer(0, 2, GL_UNSIGNED_SHORT, sizeof(instance), reinterpret_cast<const void*>(offsetof(instance, column)));
+      glVertexAttribIPointer(1, 2, GL_UNSIGNED_SHORT, sizeof(instance), reinterpret_cast<const void*>(offsetof(instance, x)));
+      glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(instance), reinterpret_cast<const void*>(offsetof(instance, fore)));
+      glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(instance), reinterpret_cast<const void*>(offsetof(instance, back)));
+      glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, sizeof(instance), reinterpret_cast<const void*>(offsetof(instance, width)));
+
+      for (GLuint location {0}; location < 5; ++location)
+      {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+      }
+
+      auto* const atlas {glyphs.glyphs().surface()};
+
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, cairo_image_surface_get_width(atlas), cairo_image_surface_get_height(atlas), 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+
+      glUseProgram(program);
+      glUniform1i(glGetUniformLocation(program, "atlas"), 0);
+      glUniform1f(glGetUniformLocation(program, "ascent"), glyphs.ascent);
+      glUniform2f(glGetUniformLocation(program, "cell_size"), glyphs.cell_width, glyphs.cell_height);
+      glUniform2f(glGetUniformLocation(program, "atlas_size"), cairo_image_surface_get_width(atlas), cairo_image_surface_get_height(atlas));
+      glUniform3f(glGetUniformLocation(program, "overlay"), rgb::from(glyphs.foreground).r, rgb::from(glyphs.foreground).g, rgb::from(glyphs.foreground).b);
+
+      viewport = glGetUniformLocation(program, "viewport");
+    }
+
+    gles_renderer(const gles_renderer&) = delete;
+    gles_renderer& operator=(const gles_renderer&) = delete;
+
+    ~gles_renderer()
+    {
+      glDeleteTextures(1, &texture);
+      glDeleteBuffers(1, &buffer);
+      glDeleteVertexArrays(1, &vertices);
+      glDeleteProgram(program);
+    }
+
+    // The size of the target in pixels.
+    void resize(const int width, const int height) noexcept
+    {
+      this->width = std::max(1, width);
+      this->height = std::max(1, height);
+      resized = true;
+    }
+
+    /**
+     * Draws the screen if anything changed since the last call and repairs
+     * its damage; true if it drew, and the caller is to present the frame.
+     */
+    bool render(screen& screen)
+    {
+      if (drawn.row != screen.cursor.row or drawn.column != screen.cursor.column or drawn.visible != screen.cursor.visible)
+      {
+        if (drawn.row < screen.rows())
+        {
+          screen.damage(drawn.row, drawn.column, drawn.column + 1);
+        }
+
+        screen.damage(screen.cursor.row, screen.cursor.column, screen.cursor.column + 1);
+      }
+
+      if (rows != screen.rows() or columns != screen.columns())
+      {
+        rows = screen.rows();
+        columns = screen.columns();
+
+        instances.assign(rows * columns, instance {});
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(instance), nullptr, GL_DYNAMIC_DRAW);
+
+        screen.damage_all();
+        resized = true;
+      }
+
+      if (not screen.damaged() and not resized)
+      {
+        return false;
+      }
+
+      drawn = screen.cursor;
+
+      auto [top, bottom] {fill(screen, false)};
+
+      // A glyph evicted may still be shown by rows that were not damaged.
+      if (glyphs.glyphs().evictions != evicted)
+      {
+        std::tie(top, bottom) = fill(screen, true);
+        evicted = glyphs.glyphs().evictions;
+      }
+
+      screen.repair();
+
+      if (top < bottom)
+      {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, top * columns * sizeof(instance), (bottom - top) * columns * sizeof(instance), instances.data() + top * columns);
+      }
+
+      if (glyphs.glyphs().misses != uploaded)
+      {
+        upload();
+      }
+
+      const auto background {rgb::from(glyphs.background)};
+
+      glViewport(0, 0, width, height);
+      glClearColor(background.r, background.g, background.b, 1);
+      glClear(GL_COLOR_BUFFER_BIT);
+
+      glUseProgram(program);
+      glUniform2f(viewport, width, height);
+      glBindVertexArray(vertices);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances.size());
+
+      resized = false;
+      return true;
+    }
+
+  private:
+    // Rewrites the instances of the damaged rows, or of every row; returns
+    // the rows [top, bottom) rewritten.
+    std::pair<std::size_t, std::size_t> fill(const screen& screen, const bool all)
+    {
+      std::size_t top {rows}, bottom {0};
+
+      const auto& marked {glyphs.marks()};
+
+      for (std::size_t row {0}; row < rows; ++row)
+      {
+        if (not all and screen.damage(row).empty())
+        {
+          continue;
+        }
+
+        top = std::min(top, row);
+        bottom = row + 1;
+
+        const auto* const cells {screen.line(row)};
+
+        const auto selection {marked and marked->first.row <= row and row <= marked->last.row ? marked->columns(row, columns) : span {0, 0}};
+
+        for (std::size_t column {0}; column < columns; ++column)
+        {
+          const auto& each {cells[column]};
+
+          auto& out {instances[row * columns + column]};
+
+          out = instance {};
+          out.column = static_cast<std::uint16_t>(column);
+          out.row = static_cast<std::uint16_t>(row);
+
+          // Covered by the double width character before.
+          if (each.flags & cell::wide_spacer)
+          {
+            continue;
+          }
+
+          const auto& rendition {screen.attributes[each.attribute]};
+
+          const auto [fore, back] {glyphs.colors(rendition)};
+
+          pack(fore, out.fore);
+          pack(back, out.back);
+
+          out.width = each.flags & cell::wide ? 2 : 1;
+          out.lines = (rendition.style & attribute::underline ? underline : 0) | (rendition.style & attribute::strike ? strike : 0);
+          out.marks = (selection.first <= column and column < selection.last ? selected : 0) | (screen.cursor.visible and screen.cursor.row == row and screen.cursor.column == column ? cursor : 0);
+
+          if (each.codepoint != U' ' and fore != back)
+          {
+            const auto at {glyphs.glyph(each.codepoint, rendition.style)};
+
+            out.x = static_cast<std::uint16_t>(at.x);
+            out.y = static_cast<std::uint16_t>(at.y);
+            out.glyph = 1;
+          }
+        }
+      }
+
+      return {top, bottom};
+    }
+
+    // The whole atlas, as glyphs were added to it.
+    void upload()
+    {
+      auto* const atlas {glyphs.glyphs().surface()};
+
+      cairo_surface_flush(atlas);
+
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, cairo_image_surface_get_stride(atlas));
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cairo_image_surface_get_width(atlas), cairo_image_surface_get_height(atlas), GL_RED, GL_UNSIGNED_BYTE, cairo_image_surface_get_data(atlas));
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+      uploaded = glyphs.glyphs().misses;
+    }
+
+    static void pack(const std::uint32_t value, std::uint8_t* const out) noexcept
+    {
+      out[0] = value >> 16 & 0xFF;
+      out[1] = value >> 8 & 0xFF;
+      out[2] = value & 0xFF;
+    }
+
+    template <typename Get, typename Log>
+    static std::string log(const GLuint object, Get&& get, Log&& read)
+    {
+      GLint size {0};
+      get(object, GL_INFO_LOG_LENGTH, &size);
+
+      std::string text(std::max(size, 1), '\0');
+      read(object, size, nullptr, text.data());
+
+      return text;
+    }
+
+    static GLuint compile(const GLenum type, const char* const source)
+    {
+      const auto shader {glCreateShader(type)};
+
+      glShaderSource(shader, 1, &source, nullptr);
+      glCompileShader(shader);
+
+      if (GLint compiled {GL_FALSE}; glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled), compiled != GL_TRUE)
+      {
+        const auto text {log(shader, glGetShaderiv, glGetShaderInfoLog)};
+        glDeleteShader(shader);
+        throw std::runtime_error {"glCompileShader: " + text};
+      }
+
+      return shader;
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_GLES_RENDERER_HPP
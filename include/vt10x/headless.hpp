@@ -0,0 +1,149 @@
+#ifndef INCLUDED_VT10X_HEADLESS_HPP
+#define INCLUDED_VT10X_HEADLESS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <cairo/cairo.h>
+
+#include <vt10x/keymap.hpp>
+#include <vt10x/renderer.hpp>
+#include <vt10x/snapshot.hpp>
+#include <vt10x/terminal.hpp>
+
+namespace vt10x
+{
+  /**
+   * Surface without a display, for benchmarks and regression tests on
+   * machines with no X server. It takes the same inputs as cairo::surface,
+   * child output and snapshots, plus synthetic keys, resizes and exposes
+   * given as plain values, and renders into an in-memory image, or nowhere
+   * when constructed without a font.
+   *
+   * Bytes the window would send to the child (key presses and terminal
+   * responses) are appended to input instead, for the caller to inspect.
+   */
+  class headless
+  {
+    std::optional<vt10x::renderer> renderer;
+
+    std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> image {nullptr, cairo_surface_destroy};
+
+  public:
+    vt10x::terminal terminal {};
+
+    std::string input {};
+
+    // Renders with the font pattern, e.g. the global font string.
+    explicit headless(const std::string_view pattern)
+      : renderer {std::in_place, pattern}
+    {
+      size(
+        static_cast<std::uint32_t>(std::ceil(terminal.screen.columns() * renderer->cell_width)),
+        static_cast<std::uint32_t>(std::ceil(terminal.screen.rows() * renderer->cell_height))
+      );
+    }
+
+    // Renders nothing: render() only repairs the damage.
+    explicit headless() = default;
+
+    headless(const headless&) = delete;
+    headless& operator=(const headless&) = delete;
+
+    // The image drawn into, null without a renderer.
+    cairo_surface_t* surface() const noexcept
+    {
+      return image.get();
+    }
+
+    // Fits the grid to the image in whole cells, as cairo::surface does; the
+    // child would be told of the size once it settled.
+    void size(const std::uint32_t width, const std::uint32_t height)
+    {
+      if (renderer)
+      {
+        image.reset(cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height));
+        renderer->invalidate();
+
+        terminal.resize(
+          std::max<std::size_t>(1, static_cast<std::size_t>(height / renderer->cell_height)),
+          std::max<std::size_t>(1, static_cast<std::size_t>(width / renderer->cell_width))
+        );
+      }
+    }
+
+    // Redraws what was damaged since the last call; true if anything was.
+    bool render()
+    {
+      if (not renderer)
+      {
+        const auto damaged {terminal.screen.damaged()};
+        terminal.screen.repair();
+        return damaged;
+      }
+
+      const auto drawn {not renderer->render(image.get(), terminal.screen).empty()};
+
+      cairo_surface_flush(image.get());
+
+      return drawn;
+    }
+
+    // Fits the image to a grid of that many cells, as a recording has it.
+    void resize(const std::size_t rows, const std::size_t columns)
+    {
+      if (renderer)
+      {
+        size(
+          static_cast<std::uint32_t>(std::ceil(columns * renderer->cell_width)),
+          static_cast<std::uint32_t>(std::ceil(rows * renderer->cell_height))
+        );
+      }
+      else
+      {
+        terminal.resize(std::max<std::size_t>(1, rows), std::max<std::size_t>(1, columns));
+      }
+    }
+
+    void expose(const double x, const double y, const double width, const double height) noexcept
+    {
+      if (renderer)
+      {
+        renderer->expose(terminal.screen, x, y, width, height);
+      }
+    }
+
+    // A key press, as a keysym with key_modifier bits.
+    void key(const std::uint32_t keysym, const unsigned modifiers = 0)
+    {
+      input += keys(keysym, modifiers, terminal.modes());
+    }
+
+    void operator()(const std::string_view chunk)
+    {
+      terminal.feed(chunk);
+
+      input += terminal.response;
+      terminal.response.clear();
+    }
+
+    void operator()(const snapshot& snapshot)
+    {
+      snapshot.apply(terminal.screen);
+    }
+
+    // For comparison against a reference image.
+    bool write_png(const std::string& path) const
+    {
+      return image and cairo_surface_write_to_png(image.get(), path.c_str()) == CAIRO_STATUS_SUCCESS;
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_HEADLESS_HPP
@@ -0,0 +1,292 @@
+#ifndef INCLUDED_VT10X_KEYMAP_HPP
+#define INCLUDED_VT10X_KEYMAP_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace vt10x
+{
+  // Bytes a key sends to the child; at most "\x1B[24;8~".
+  struct key_sequence
+  {
+    char bytes[7];
+
+    std::uint8_t size;
+
+    constexpr void append(const char byte) noexcept
+    {
+      bytes[size++] = byte;
+    }
+
+    constexpr void append(const unsigned number) noexcept
+    {
+      if (10 <= number)
+      {
+        append(static_cast<char>('0' + number / 10));
+      }
+      append(static_cast<char>('0' + number % 10));
+    }
+
+    constexpr std::string_view view() const noexcept
+    {
+      return {bytes, size};
+    }
+  };
+
+  static_assert(sizeof(key_sequence) == 8);
+
+  // Bit values as in the xterm modifier parameter, which is 1 + their sum.
+  enum key_modifier : unsigned
+  {
+    shift = 1, meta = 2, control = 4,
+  };
+
+  enum key_mode : unsigned
+  {
+    application_cursor = 1, application_keypad = 2,
+
+    bracketed_paste = 4, // not of keys, but of pastes
+  };
+
+  /**
+   * Keysym to bytes translation, built at compile time so that a key press
+   * costs one array lookup. Latin-1 keysyms are indexed by (keysym, modifiers)
+   * and the function key page 0xFF00-0xFFFF by (modes, keysym, modifiers).
+   * Sequences follow xterm, which the vt10x terminfo entry is modelled on.
+   */
+  class keymap
+  {
+    std::array<key_sequence, 256 * 8> latin;
+
+    std::array<key_sequence, 4 * 256 * 8> functions;
+
+  public:
+    constexpr keymap()
+      : latin {}
+      , functions {}
+    {
+      for (unsigned keysym {0x20}; keysym < 0x100; ++keysym)
+      {
+        if (0x7F <= keysym and keysym < 0xA0)
+        {
+          continue; // no such keysyms
+        }
+
+        for (unsigned modifiers {0}; modifiers < 8; ++modifiers)
+        {
+          auto& sequence {latin[keysym << 3 | modifiers]};
+
+          if (modifiers & meta)
+          {
+            sequence.append('\x1B');
+          }
+
+          if (modifiers & control and 0x80 > keysym)
+          {
+            sequence.append(controlled(keysym));
+          }
+          else if (keysym < 0x80)
+          {
+            sequence.append(static_cast<char>(keysym));
+          }
+          else // UTF-8
+          {
+            sequence.append(static_cast<char>(0xC0 | keysym >> 6));
+            sequence.append(static_cast<char>(0x80 | (keysym & 0x3F)));
+          }
+        }
+      }
+
+      for (unsigned modes {0}; modes < 4; ++modes)
+      {
+        for (unsigned modifiers {0}; modifiers < 8; ++modifiers)
+        {
+          const auto at = [&](const unsigned keysym) -> decltype(auto)
+          {
+            return functions[(modes << 8 | (keysym & 0xFF)) << 3 | modifiers];
+          };
+
+          const auto plain = [&](const unsigned keysym, const char byte)
+          {
+            auto& sequence {at(keysym)};
+
+            if (modifiers & meta)
+            {
+              sequence.append('\x1B');
+            }
+            sequence.append(byte);
+          };
+
+          plain(0xFF08, modifiers & control ? '\x08' : '\x7F'); // BackSpace
+          plain(0xFF0D, '\r');                                  // Return
+          plain(0xFF1B, '\x1B');                                // Escape
+
+          if (modifiers & shift)
+          {
+            csi(at(0xFF09), 'Z', modifiers & ~shift);           // Tab
+          }
+          else
+          {
+            plain(0xFF09, '\t');
+          }
+
+          const auto cursor = [&](const unsigned keysym, const char final)
+          {
+            ss3_or_csi(at(keysym), final, modifiers, modes & application_cursor);
+          };
+
+          cursor(0xFF50, 'H'); cursor(0xFF95, 'H'); // Home, KP_Home
+          cursor(0xFF51, 'D'); cursor(0xFF96, 'D'); // Left, KP_Left
+          cursor(0xFF52, 'A'); cursor(0xFF97, 'A'); // Up, KP_Up
+          cursor(0xFF53, 'C'); cursor(0xFF98, 'C'); // Right, KP_Right
+          cursor(0xFF54, 'B'); cursor(0xFF99, 'B'); // Down, KP_Down
+          cursor(0xFF57, 'F'); cursor(0xFF9C, 'F'); // End, KP_End
+          cursor(0xFF9D, 'E');                      // KP_Begin
+
+          const auto editing = [&](const unsigned keysym, const unsigned number)
+          {
+            tilde(at(keysym), number, modifiers);
+          };
+
+          editing(0xFF63, 2); editing(0xFF9E, 2); // Insert, KP_Insert
+          editing(0xFFFF, 3); editing(0xFF9F, 3); // Delete, KP_Delete
+          editing(0xFF55, 5); editing(0xFF9A, 5); // Prior, KP_Prior
+          editing(0xFF56, 6); editing(0xFF9B, 6); // Next, KP_Next
+
+          // F1-F4 are SS3 P-S; F5-F12 are numbered with gaps, as on a VT220.
+          constexpr unsigned numbers[] {15, 17, 18, 19, 20, 21, 23, 24};
+
+          for (unsigned index {0}; index < 4; ++index)
+          {
+            ss3_or_csi(at(0xFFBE + index), static_cast<char>('P' + index), modifiers, true);
+          }
+
+          for (unsigned index {0}; index < 8; ++index)
+          {
+            editing(0xFFC2 + index, numbers[index]);
+          }
+
+          const auto keypad = [&](const unsigned keysym, const char byte, const char application)
+          {
+            if (modes & application_keypad)
+            {
+              ss3_or_csi(at(keysym), application, modifiers, true);
+            }
+            else
+            {
+              plain(keysym, byte);
+            }
+          };
+
+          keypad(0xFF8D, '\r', 'M'); // KP_Enter
+          keypad(0xFFAA, '*', 'j');
+          keypad(0xFFAB, '+', 'k');
+          keypad(0xFFAC, ',', 'l');
+          keypad(0xFFAD, '-', 'm');
+          keypad(0xFFAE, '.', 'n');
+          keypad(0xFFAF, '/', 'o');
+          keypad(0xFFBD, '=', 'X');
+
+          for (unsigned index {0}; index < 10; ++index)
+          {
+            keypad(0xFFB0 + index, static_cast<char>('0' + index), static_cast<char>('p' + index));
+          }
+        }
+      }
+    }
+
+    // The bytes for keysym, which are empty if it sends nothing.
+    constexpr std::string_view operator()(const std::uint32_t keysym, const unsigned modifiers, const unsigned modes) const noexcept
+    {
+      if (keysym < 0x100)
+      {
+        return latin[keysym << 3 | (modifiers & 7)].view();
+      }
+      else if ((keysym & ~0xFFu) == 0xFF00)
+      {
+        return functions[((modes & 3) << 8 | (keysym & 0xFF)) << 3 | (modifiers & 7)].view();
+      }
+      else if (keysym == 0xFE20) // ISO_Left_Tab, i.e. Shift+Tab on most layouts
+      {
+        return functions[((modes & 3) << 8 | 0x09) << 3 | (modifiers & 7) | shift].view();
+      }
+      else
+      {
+        return {};
+      }
+    }
+
+  private:
+    static constexpr char controlled(const unsigned keysym) noexcept
+    {
+      switch (keysym)
+      {
+      case ' ': case '2': case '@':
+        return '\x00';
+
+      case '3': case '4': case '5': case '6': case '7':
+        return static_cast<char>(keysym - '3' + 0x1B);
+
+      case '/':
+        return '\x1F';
+
+      case '8': case '?':
+        return '\x7F';
+
+      default:
+        return 0x40 <= keysym and keysym < 0x7F ? static_cast<char>(keysym & 0x1F) : static_cast<char>(keysym);
+      }
+    }
+
+    static constexpr void csi(key_sequence& sequence, const char final, const unsigned modifiers) noexcept
+    {
+      sequence.append('\x1B');
+      sequence.append('[');
+
+      if (modifiers)
+      {
+        sequence.append('1');
+        sequence.append(';');
+        sequence.append(1 + modifiers);
+      }
+
+      sequence.append(final);
+    }
+
+    // Unmodified keys send SS3 in the corresponding application mode, CSI
+    // otherwise; modified keys always send CSI 1 ; modifiers.
+    static constexpr void ss3_or_csi(key_sequence& sequence, const char final, const unsigned modifiers, const bool application) noexcept
+    {
+      if (application and not modifiers)
+      {
+        sequence.append('\x1B');
+        sequence.append('O');
+        sequence.append(final);
+      }
+      else
+      {
+        csi(sequence, final, modifiers);
+      }
+    }
+
+    static constexpr void tilde(key_sequence& sequence, const unsigned number, const unsigned modifiers) noexcept
+    {
+      sequence.append('\x1B');
+      sequence.append('[');
+      sequence.append(number);
+
+      if (modifiers)
+      {
+        sequence.append(';');
+        sequence.append(1 + modifiers);
+      }
+
+      sequence.append('~');
+    }
+  };
+
+  inline constexpr keymap keys {};
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_KEYMAP_HPP
@@ -0,0 +1,100 @@
+#ifndef INCLUDED_VT10X_LISTENER_HPP
+#define INCLUDED_VT10X_LISTENER_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace vt10x
+{
+  inline sockaddr_un unix_address(const std::string& path)
+  {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if (sizeof(address.sun_path) <= path.size())
+    {
+      throw std::system_error {ENAMETOOLONG, std::generic_category(), path};
+    }
+
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    return address;
+  }
+
+  // http://man7.org/linux/man-pages/man7/unix.7.html
+  class listener
+  {
+    const std::string path;
+
+    const int fd;
+
+  public:
+    // Binds path, replacing a socket left behind by a process that died.
+    explicit listener(const std::string& path)
+      : path {path}
+      , fd {socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)}
+    {
+      const auto address {unix_address(path)};
+
+      unlink(address.sun_path);
+
+      if (fd < 0 or bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) or ::listen(fd, 16))
+      {
+        const auto error {errno};
+
+        if (0 <= fd)
+        {
+          close(fd);
+        }
+
+        throw std::system_error {error, std::generic_category(), path};
+      }
+    }
+
+    listener(const listener&) = delete;
+    listener& operator=(const listener&) = delete;
+
+    ~listener()
+    {
+      close(fd);
+      unlink(path.c_str());
+    }
+
+    auto descriptor() const noexcept
+    {
+      return fd;
+    }
+
+    // A connected client, -1 if none is waiting; flags as of accept4(2).
+    int accept(const int flags = 0) const noexcept
+    {
+      return accept4(fd, nullptr, nullptr, SOCK_CLOEXEC | flags);
+    }
+  };
+
+  // Connects to the listener at path; -1 with errno set if there is none.
+  inline int dial(const std::string& path)
+  {
+    const auto address {unix_address(path)};
+
+    const auto fd {socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+
+    if (0 <= fd and connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)))
+    {
+      const auto error {errno};
+      close(fd);
+      errno = error;
+      return -1;
+    }
+
+    return fd;
+  }
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_LISTENER_HPP
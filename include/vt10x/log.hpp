@@ -0,0 +1,404 @@
+#ifndef INCLUDED_VT10X_LOG_HPP
+#define INCLUDED_VT10X_LOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include <unistd.h>
+
+// Records below this level are compiled out: 0 trace, 1 debug, 2 info,
+// 3 warning, 4 error.
+#ifndef VT10X_LOG_LEVEL
+#ifdef NDEBUG
+#define VT10X_LOG_LEVEL 2
+#else
+#define VT10X_LOG_LEVEL 0
+#endif // NDEBUG
+#endif // VT10X_LOG_LEVEL
+
+namespace vt10x::log
+{
+  enum class level : std::uint8_t
+  {
+    trace, debug, info, warning, error,
+  };
+
+  inline constexpr auto threshold {static_cast<level>(VT10X_LOG_LEVEL)};
+
+  /**
+   * Flight recorder of the most recent records. Logging stores a pointer to
+   * the format string literal and up to four integral arguments into a cache
+   * line sized slot, without locks, allocation or formatting; records are
+   * formatted only when they are written out.
+   *
+   * Any number of threads may log. Slots are overwritten oldest first, and a
+   * reader detects torn slots by their sequence numbers (a seqlock): every
+   * field is a relaxed atomic, so reading while writing is well defined.
+   */
+  class ring
+  {
+  public:
+    static constexpr std::size_t capacity {4096};
+
+    static constexpr std::size_t arity {4};
+
+  private:
+    struct alignas(64) slot
+    {
+      std::atomic<std::uint64_t> sequence {0}; // 2 * (index + 1) once complete
+
+      std::atomic<std::uint64_t> time {0}, format {0}, header {0};
+
+      std::atomic<std::uint64_t> arguments[arity] {};
+    };
+
+    slot slots[capacity];
+
+    std::atomic<std::uint64_t> head {0};
+
+  public:
+    struct record
+    {
+      std::uint64_t time; // nanoseconds since the first record
+
+      const char* format;
+
+      level severity;
+
+      std::uint8_t size, negative; // bit i: argument i is signed and negative
+
+      std::uint64_t arguments[arity];
+    };
+
+    void push(const level severity, const char* const format, const std::uint8_t size, const std::uint8_t negative, const std::uint64_t (&arguments)[arity]) noexcept
+    {
+      const auto index {head.fetch_add(1, std::memory_order_relaxed)};
+
+      auto& entry {slots[index % capacity]};
+
+      entry.sequence.store(2 * index + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      entry.time.store(now(), std::memory_order_relaxed);
+      entry.format.store(reinterpret_cast<std::uintptr_t>(format), std::memory_order_relaxed);
+      entry.header.store(static_cast<std::uint64_t>(severity) | size << 8 | negative << 16, std::memory_order_relaxed);
+
+      for (std::size_t argument {0}; argument < arity; ++argument)
+      {
+        entry.arguments[argument].store(arguments[argument], std::memory_order_relaxed);
+      }
+
+      entry.sequence.store(2 * index + 2, std::memory_order_release);
+    }
+
+    // Index one past the latest record.
+    auto end() const noexcept
+    {
+      return head.load(std::memory_order_acquire);
+    }
+
+    // Index of the oldest record still held.
+    auto begin() const noexcept
+    {
+      const auto last {end()};
+      return last < capacity ? 0 : last - capacity;
+    }
+
+    // Copies the record at index out; false if it was overwritten or is
+    // still being written.
+    bool read(const std::uint64_t index, record& out) const noexcept
+    {
+      const auto& entry {slots[index % capacity]};
+
+      if (entry.sequence.load(std::memory_order_acquire) != 2 * index + 2)
+      {
+        return false;
+      }
+
+      out.time = entry.time.load(std::memory_order_relaxed);
+      out.format = reinterpret_cast<const char*>(entry.format.load(std::memory_order_relaxed));
+
+      const auto header {entry.header.load(std::memory_order_relaxed)};
+
+      out.severity = static_cast<level>(header & 0xFF);
+      out.size = header >> 8 & 0xFF;
+      out.negative = header >> 16 & 0xFF;
+
+      for (std::size_t argument {0}; argument < arity; ++argument)
+      {
+        out.arguments[argument] = entry.arguments[argument].load(std::memory_order_relaxed);
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      return entry.sequence.load(std::memory_order_relaxed) == 2 * index + 2;
+    }
+
+    /**
+     * Formats the records in [first, last) and writes them to fd. Only uses
+     * write(2) and stack buffers, so it is async-signal-safe and may run in a
+     * crash handler. Returns last.
+     */
+    std::uint64_t write(const int fd, std::uint64_t first, const std::uint64_t last) const noexcept
+    {
+      for (record entry {}; first < last; ++first)
+      {
+        if (read(first, entry))
+        {
+          format(fd, entry);
+        }
+      }
+
+      return last;
+    }
+
+  private:
+    static std::uint64_t now() noexcept
+    {
+      static const auto epoch {std::chrono::steady_clock::now()};
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    static void format(const int fd, const record& entry) noexcept
+    {
+      char line[512];
+      std::size_t size {0};
+
+      const auto put = [&](const char c) noexcept
+      {
+        if (size < sizeof(line) - 1)
+        {
+          line[size++] = c;
+        }
+      };
+
+      const auto number = [&](std::uint64_t value, const std::size_t width = 0) noexcept
+      {
+        char digits[20];
+        std::size_t count {0};
+
+        do
+        {
+          digits[count++] = static_cast<char>('0' + value % 10);
+          value /= 10;
+        }
+        while (value);
+
+        for (auto pad {count}; pad < width; ++pad)
+        {
+          put('0');
+        }
+
+        while (count)
+        {
+          put(digits[--count]);
+        }
+      };
+
+      constexpr const char* names[] {"trace", "debug", "info", "warn", "error"};
+
+      put('[');
+      number(entry.time / 1000000000);
+      put('.');
+      number(entry.time / 1000 % 1000000, 6);
+      put(']');
+      put(' ');
+
+      for (const auto* name {names[static_cast<std::size_t>(entry.severity) % 5]}; *name; ++name)
+      {
+        put(*name);
+      }
+
+      put('\t');
+
+      std::size_t argument {0};
+
+      for (const auto* c {entry.format}; *c; ++c)
+      {
+        if (c[0] == '{' and c[1] == '}' and argument < entry.size)
+        {
+          if (entry.negative & 1 << argument)
+          {
+            put('-');
+            number(-entry.arguments[argument]);
+          }
+          else
+          {
+            number(entry.arguments[argument]);
+          }
+
+          ++argument;
+          ++c;
+        }
+        else
+        {
+          put(*c);
+        }
+      }
+
+      line[size++] = '\n';
+
+      for (std::size_t written {0}; written < size; )
+      {
+        if (const auto result {::write(fd, line + written, size - written)}; 0 < result)
+        {
+          written += result;
+        }
+        else
+        {
+          break;
+        }
+      }
+    }
+  };
+
+  inline ring records {};
+
+  template <typename T>
+  constexpr std::uint64_t word(const T value) noexcept
+  {
+    if constexpr (std::is_pointer<T>::value)
+    {
+      return reinterpret_cast<std::uintptr_t>(value);
+    }
+    else if constexpr (std::is_enum<T>::value)
+    {
+      return static_cast<std::uint64_t>(static_cast<std::underlying_type_t<T>>(value));
+    }
+    else
+    {
+      return static_cast<std::uint64_t>(value);
+    }
+  }
+
+  template <typename T>
+  constexpr bool negative(const T value) noexcept
+  {
+    if constexpr (std::is_signed<T>::value)
+    {
+      return value < 0;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  /**
+   * Logs format, in which each {} stands for the next argument. format must
+   * be a string literal: only its address is recorded. Below the compile
+   * time threshold this is an empty function.
+   */
+  template <level Level, typename... Ts>
+  void write([[maybe_unused]] const char* const format, [[maybe_unused]] const Ts... arguments) noexcept
+  {
+    if constexpr (threshold <= Level)
+    {
+      static_assert(sizeof...(Ts) <= ring::arity, "too many arguments to log");
+
+      std::uint64_t words[ring::arity] {word(arguments)...};
+
+      std::uint8_t signs {0}, index {0};
+      ((signs |= negative(arguments) << index++), ...);
+
+      records.push(Level, format, sizeof...(Ts), signs, words);
+    }
+  }
+
+  template <typename... Ts> void trace(const char* const format, const Ts... arguments) noexcept { write<level::trace>(format, arguments...); }
+  template <typename... Ts> void debug(const char* const format, const Ts... arguments) noexcept { write<level::debug>(format, arguments...); }
+  template <typename... Ts> void info(const char* const format, const Ts... arguments) noexcept { write<level::info>(format, arguments...); }
+  template <typename... Ts> void warning(const char* const format, const Ts... arguments) noexcept { write<level::warning>(format, arguments...); }
+  template <typename... Ts> void error(const char* const format, const Ts... arguments) noexcept { write<level::error>(format, arguments...); }
+
+  // Writes every record still held to fd.
+  inline void dump(const int fd) noexcept
+  {
+    records.write(fd, records.begin(), records.end());
+  }
+
+  /**
+   * Dumps the ring to stderr on SIGUSR2, and on fatal signals before the
+   * default action runs, so that a crash report ends with what led to it.
+   */
+  inline void install_handlers()
+  {
+    struct sigaction action {};
+
+    action.sa_handler = [](int)
+    {
+      dump(STDERR_FILENO);
+    };
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    sigaction(SIGUSR2, &action, nullptr);
+
+    action.sa_handler = [](int signal)
+    {
+      dump(STDERR_FILENO);
+      std::raise(signal); // SA_RESETHAND restored the default action
+    };
+    action.sa_flags = SA_RESETHAND;
+
+    for (const auto signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT})
+    {
+      sigaction(signal, &action, nullptr);
+    }
+  }
+
+  /**
+   * Writes new records to fd from a thread of its own every interval, so
+   * that the threads that log never wait for the file.
+   */
+  class drainer
+  {
+    const int fd;
+
+    std::mutex mutex {};
+
+    std::condition_variable condition {};
+
+    bool stopping {false};
+
+    std::thread thread;
+
+  public:
+    explicit drainer(const int fd, const std::chrono::milliseconds interval = std::chrono::milliseconds {100})
+      : fd {fd}
+      , thread {[this, interval]()
+        {
+          auto next {records.begin()};
+
+          for (std::unique_lock<std::mutex> lock {mutex}; not stopping; )
+          {
+            condition.wait_for(lock, interval);
+            next = records.write(this->fd, std::max(next, records.begin()), records.end());
+          }
+        }}
+    {}
+
+    drainer(const drainer&) = delete;
+    drainer& operator=(const drainer&) = delete;
+
+    ~drainer()
+    {
+      {
+        const std::lock_guard<std::mutex> lock {mutex};
+        stopping = true;
+      }
+      condition.notify_one();
+      thread.join();
+    }
+  };
+} // namespace vt10x::log
+
+#endif // INCLUDED_VT10X_LOG_HPP
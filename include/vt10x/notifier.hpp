@@ -0,0 +1,56 @@
+#ifndef INCLUDED_VT10X_NOTIFIER_HPP
+#define INCLUDED_VT10X_NOTIFIER_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace vt10x
+{
+  // http://man7.org/linux/man-pages/man2/eventfd.2.html
+  class notifier
+  {
+    const int descriptor_;
+
+  public:
+    explicit notifier()
+      : descriptor_ {eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+    {
+      if (descriptor_ < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "eventfd"};
+      }
+    }
+
+    notifier(const notifier&) = delete;
+    notifier& operator=(const notifier&) = delete;
+
+    ~notifier()
+    {
+      close(descriptor_);
+    }
+
+    auto descriptor() const noexcept
+    {
+      return descriptor_;
+    }
+
+    // Makes the descriptor readable. Signals coalesce until cleared.
+    void signal() const noexcept
+    {
+      const std::uint64_t one {1};
+      static_cast<void>(write(descriptor_, &one, sizeof(one)));
+    }
+
+    void clear() const noexcept
+    {
+      std::uint64_t count {0};
+      static_cast<void>(read(descriptor_, &count, sizeof(count)));
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_NOTIFIER_HPP
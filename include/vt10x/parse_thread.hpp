@@ -0,0 +1,219 @@
+#ifndef INCLUDED_VT10X_PARSE_THREAD_HPP
+#define INCLUDED_VT10X_PARSE_THREAD_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <vt10x/notifier.hpp>
+#include <vt10x/pseudo_terminal.hpp>
+#include <vt10x/reactor.hpp>
+#include <vt10x/snapshot.hpp>
+#include <vt10x/spsc_ring.hpp>
+#include <vt10x/statistics.hpp>
+#include <vt10x/terminal.hpp>
+
+namespace vt10x
+{
+  /**
+   * Reads the PTY and feeds the terminal on a thread of its own, handing the
+   * damage to the render thread as snapshots through a lock-free ring. When
+   * the ring is full the thread keeps reading and parsing: damage piles up in
+   * the grid and goes out with the next free slot, so a slow frame never
+   * stops the child from writing.
+   *
+   * The terminal belongs to this thread from construction to destruction.
+   */
+  class parse_thread
+  {
+    pseudo_terminal& pty;
+
+    terminal& term;
+
+    spsc_ring<snapshot, 4> ring {};
+
+    notifier ready {}, wakeup {};
+
+    std::atomic<bool> stopping {false}, hung_up_ {false};
+
+    std::atomic<std::uint64_t> geometry {0}; // rows << 32 | columns, 0 once applied
+
+    std::size_t shipped_attributes {0};
+
+    unsigned shipped_modes {0};
+
+    bool shipped_synchronized {false};
+
+    // Earliest PTY read not shipped yet, if unshipped.
+    std::chrono::steady_clock::time_point first_read {};
+
+    bool unshipped {false};
+
+    std::thread thread;
+
+    enum source : std::uint64_t
+    {
+      pseudo_terminal_, consumer
+    };
+
+  public:
+    // Upper bound of PTY batches consumed before shipping a snapshot.
+    static constexpr auto batch_limit {16};
+
+    explicit parse_thread(pseudo_terminal& pty, terminal& term)
+      : pty {pty}
+      , term {term}
+      , thread {[this]() { run(); }}
+    {}
+
+    parse_thread(const parse_thread&) = delete;
+    parse_thread& operator=(const parse_thread&) = delete;
+
+    ~parse_thread()
+    {
+      stopping.store(true, std::memory_order_relaxed);
+      wakeup.signal();
+      thread.join();
+    }
+
+    // Readable when snapshots are waiting or the child has hung up.
+    auto descriptor() const noexcept
+    {
+      return ready.descriptor();
+    }
+
+    auto hung_up() const noexcept
+    {
+      return hung_up_.load(std::memory_order_acquire);
+    }
+
+    // Makes the thread look at the PTY again, e.g. after input was left
+    // pending by a write from another thread.
+    void wake() const noexcept
+    {
+      wakeup.signal();
+    }
+
+    // Resizes the terminal before it parses more; only the last of several
+    // sizes requested meanwhile is applied.
+    void resize(const std::size_t rows, const std::size_t columns) noexcept
+    {
+      geometry.store(std::uint64_t {rows} << 32 | columns, std::memory_order_release);
+      wakeup.signal();
+    }
+
+    // Calls f(snapshot) for every waiting snapshot, oldest first.
+    template <typename F>
+    void consume(F&& f)
+    {
+      ready.clear();
+
+      for (auto* slot {ring.peek()}; slot; slot = ring.peek())
+      {
+        f(static_cast<const snapshot&>(*slot));
+        ring.release();
+        wakeup.signal();
+      }
+    }
+
+  private:
+    void run()
+    {
+      reactor reactor {};
+
+      reactor.watch(pty.descriptor(), pseudo_terminal_);
+      reactor.watch(wakeup.descriptor(), consumer);
+
+      for (auto output {false}; not pty.hung_up() and not stopping.load(std::memory_order_relaxed); )
+      {
+        reactor.wait(-1, [&](auto source, auto flags)
+        {
+          if (source == consumer)
+          {
+            wakeup.clear();
+            return;
+          }
+
+          // The render thread hears of room in the PTY, for a paste waiting
+          // for it.
+          if (flags & EPOLLOUT and pty.flush())
+          {
+            ready.signal();
+          }
+
+          for (auto batch {0}; batch < batch_limit and flags & (EPOLLIN | EPOLLHUP); ++batch)
+          {
+            if (const auto chunk {pty.read()}; not chunk.empty())
+            {
+              stats.bytes.fetch_add(chunk.size(), std::memory_order_relaxed);
+              stats.reads.fetch_add(1, std::memory_order_relaxed);
+
+              if (not unshipped)
+              {
+                first_read = std::chrono::steady_clock::now();
+                unshipped = true;
+              }
+
+              term.feed(chunk);
+            }
+            else
+            {
+              break;
+            }
+          }
+
+          if (not term.response.empty())
+          {
+            pty.write(term.response);
+            term.response.clear();
+          }
+        });
+
+        if (const auto size {geometry.exchange(0, std::memory_order_acquire)}; size)
+        {
+          term.resize(size >> 32, size & 0xFFFFFFFF);
+        }
+
+        ship();
+
+        if (pty.blocked() != output)
+        {
+          output = not output;
+          reactor.modify(pty.descriptor(), pseudo_terminal_, output ? EPOLLIN | EPOLLOUT : EPOLLIN);
+        }
+      }
+
+      hung_up_.store(true, std::memory_order_release);
+      ready.signal();
+    }
+
+    void ship()
+    {
+      if (not term.screen.damaged() and term.modes() == shipped_modes and term.synchronized == shipped_synchronized)
+      {
+        return;
+      }
+
+      if (auto* slot {ring.claim()}; slot)
+      {
+        const auto attributes {term.screen.attributes.size()};
+
+        slot->capture(term.screen, attributes != shipped_attributes);
+        shipped_attributes = attributes;
+
+        slot->modes = shipped_modes = term.modes();
+        slot->synchronized = shipped_synchronized = term.synchronized;
+
+        slot->read = unshipped ? first_read : std::chrono::steady_clock::now();
+        unshipped = false;
+
+        ring.publish();
+        ready.signal();
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_PARSE_THREAD_HPP
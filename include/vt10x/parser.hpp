@@ -0,0 +1,409 @@
+#ifndef INCLUDED_VT10X_PARSER_HPP
+#define INCLUDED_VT10X_PARSER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <vt10x/simd.hpp>
+
+namespace vt10x
+{
+  // https://vt100.net/emu/dec_ansi_parser
+  enum class state : std::uint8_t
+  {
+    ground,
+    escape,
+    escape_intermediate,
+    csi_entry,
+    csi_param,
+    csi_intermediate,
+    csi_ignore,
+    dcs_entry,
+    dcs_param,
+    dcs_intermediate,
+    dcs_passthrough,
+    dcs_ignore,
+    osc_string,
+    sos_pm_apc_string,
+  };
+
+  enum class action : std::uint8_t
+  {
+    ignore,
+    print,
+    execute,
+    collect,
+    param,
+    esc_dispatch,
+    csi_dispatch,
+    put,
+    osc_put,
+  };
+
+  /**
+   * Transition table indexed by [state][byte]. Each entry packs the action in
+   * the upper nibble and the next state in the lower one. Entry and exit
+   * actions (clear, hook, unhook, osc_start and osc_end) are implied by the
+   * state changes and performed by the parser.
+   *
+   * C1 controls are not recognized, since 0x80-0x9F are UTF-8 continuation
+   * bytes on this terminal; 8-bit bytes are printed or passed through.
+   */
+  class transition_table
+  {
+    std::array<std::array<std::uint8_t, 256>, 14> entries {};
+
+    constexpr void set(const state from, const unsigned first, const unsigned last, const action what, const state to)
+    {
+      for (auto byte {first}; byte <= last; ++byte)
+      {
+        entries[static_cast<std::size_t>(from)][byte]
+          = static_cast<std::uint8_t>(static_cast<unsigned>(what) << 4 | static_cast<unsigned>(to));
+      }
+    }
+
+    constexpr void set(const state from, const unsigned first, const unsigned last, const action what)
+    {
+      set(from, first, last, what, from);
+    }
+
+    // C0 controls except CAN, SUB and ESC, which are handled from anywhere.
+    constexpr void set_c0(const state from, const action what)
+    {
+      set(from, 0x00, 0x17, what);
+      set(from, 0x19, 0x19, what);
+      set(from, 0x1C, 0x1F, what);
+    }
+
+  public:
+    constexpr transition_table()
+    {
+      for (auto from {0u}; from < entries.size(); ++from)
+      {
+        set(static_cast<state>(from), 0x00, 0xFF, action::ignore);
+        set(static_cast<state>(from), 0x18, 0x18, action::execute, state::ground);
+        set(static_cast<state>(from), 0x1A, 0x1A, action::execute, state::ground);
+        set(static_cast<state>(from), 0x1B, 0x1B, action::ignore, state::escape);
+      }
+
+      set_c0(state::ground, action::execute);
+      set(state::ground, 0x20, 0x7E, action::print);
+      set(state::ground, 0x80, 0xFF, action::print);
+
+      set_c0(state::escape, action::execute);
+      set(state::escape, 0x20, 0x2F, action::collect, state::escape_intermediate);
+      set(state::escape, 0x30, 0x7E, action::esc_dispatch, state::ground);
+      set(state::escape, 0x50, 0x50, action::ignore, state::dcs_entry);
+      set(state::escape, 0x58, 0x58, action::ignore, state::sos_pm_apc_string);
+      set(state::escape, 0x5B, 0x5B, action::ignore, state::csi_entry);
+      set(state::escape, 0x5D, 0x5D, action::ignore, state::osc_string);
+      set(state::escape, 0x5E, 0x5F, action::ignore, state::sos_pm_apc_string);
+
+      set_c0(state::escape_intermediate, action::execute);
+      set(state::escape_intermediate, 0x20, 0x2F, action::collect);
+      set(state::escape_intermediate, 0x30, 0x7E, action::esc_dispatch, state::ground);
+
+      set_c0(state::csi_entry, action::execute);
+      set(state::csi_entry, 0x20, 0x2F, action::collect, state::csi_intermediate);
+      set(state::csi_entry, 0x30, 0x3B, action::param, state::csi_param); // 0x3A is a sub-parameter separator
+      set(state::csi_entry, 0x3C, 0x3F, action::collect, state::csi_param);
+      set(state::csi_entry, 0x40, 0x7E, action::csi_dispatch, state::ground);
+
+      set_c0(state::csi_param, action::execute);
+      set(state::csi_param, 0x20, 0x2F, action::collect, state::csi_intermediate);
+      set(state::csi_param, 0x30, 0x3B, action::param);
+      set(state::csi_param, 0x3C, 0x3F, action::ignore, state::csi_ignore);
+      set(state::csi_param, 0x40, 0x7E, action::csi_dispatch, state::ground);
+
+      set_c0(state::csi_intermediate, action::execute);
+      set(state::csi_intermediate, 0x20, 0x2F, action::collect);
+      set(state::csi_intermediate, 0x30, 0x3F, action::ignore, state::csi_ignore);
+      set(state::csi_intermediate, 0x40, 0x7E, action::csi_dispatch, state::ground);
+
+      set_c0(state::csi_ignore, action::execute);
+      set(state::csi_ignore, 0x40, 0x7E, action::ignore, state::ground);
+
+      set(state::dcs_entry, 0x20, 0x2F, action::collect, state::dcs_intermediate);
+      set(state::dcs_entry, 0x30, 0x39, action::param, state::dcs_param);
+      set(state::dcs_entry, 0x3A, 0x3A, action::ignore, state::dcs_ignore);
+      set(state::dcs_entry, 0x3B, 0x3B, action::param, state::dcs_param);
+      set(state::dcs_entry, 0x3C, 0x3F, action::collect, state::dcs_param);
+      set(state::dcs_entry, 0x40, 0x7E, action::ignore, state::dcs_passthrough);
+
+      set(state::dcs_param, 0x20, 0x2F, action::collect, state::dcs_intermediate);
+      set(state::dcs_param, 0x30, 0x39, action::param);
+      set(state::dcs_param, 0x3A, 0x3A, action::ignore, state::dcs_ignore);
+      set(state::dcs_param, 0x3B, 0x3B, action::param);
+      set(state::dcs_param, 0x3C, 0x3F, action::ignore, state::dcs_ignore);
+      set(state::dcs_param, 0x40, 0x7E, action::ignore, state::dcs_passthrough);
+
+      set(state::dcs_intermediate, 0x20, 0x2F, action::collect);
+      set(state::dcs_intermediate, 0x30, 0x3F, action::ignore, state::dcs_ignore);
+      set(state::dcs_intermediate, 0x40, 0x7E, action::ignore, state::dcs_passthrough);
+
+      set_c0(state::dcs_passthrough, action::put);
+      set(state::dcs_passthrough, 0x20, 0x7E, action::put);
+      set(state::dcs_passthrough, 0x80, 0xFF, action::put);
+
+      set(state::osc_string, 0x07, 0x07, action::ignore, state::ground); // xterm accepts BEL as ST
+      set(state::osc_string, 0x20, 0x7E, action::osc_put);
+      set(state::osc_string, 0x80, 0xFF, action::osc_put);
+    }
+
+    constexpr auto operator()(const state from, const unsigned char byte) const noexcept
+    {
+      return entries[static_cast<std::size_t>(from)][byte];
+    }
+  };
+
+  inline constexpr transition_table transitions {};
+
+  struct parameters
+  {
+    static constexpr std::size_t capacity {16};
+
+    std::array<std::uint32_t, capacity> values;
+
+    std::size_t size;
+
+    std::uint32_t subparameters; // bit N is set if values[N] follows ':'
+
+    // ECMA-48 treats an omitted or zero parameter as the default value.
+    auto operator()(const std::size_t index, const std::uint32_t fallback) const noexcept
+    {
+      return index < size and values[index] ? values[index] : fallback;
+    }
+
+    auto operator[](const std::size_t index) const noexcept
+    {
+      return index < size ? values[index] : 0;
+    }
+
+    auto is_subparameter(const std::size_t index) const noexcept
+    {
+      return index < size and (subparameters >> index & 1);
+    }
+  };
+
+  /**
+   * DEC compatible state machine. Derived receives the semantic callbacks,
+   * each of which has a no-op default here:
+   *
+   *   print(first, last)                  run of printable bytes
+   *   execute(byte)                       C0 control
+   *   esc_dispatch(intermediates, final)  ESC sequence
+   *   csi_dispatch(parameters, intermediates, final)
+   *   hook(parameters, intermediates, final), put(byte), unhook()
+   *   osc_dispatch(string)
+   *
+   * Input may be split anywhere; the state is kept between calls of feed.
+   */
+  template <typename Derived>
+  class parser
+  {
+    vt10x::state current {state::ground};
+
+    vt10x::parameters parameters {};
+
+    std::array<char, 2> intermediates {};
+
+    std::size_t intermediates_size {0};
+
+    std::array<char, 512> osc {};
+
+    std::size_t osc_size {0};
+
+  public:
+    void feed(const char* first, const char* const last)
+    {
+      while (first != last)
+      {
+        if (current == state::ground)
+        {
+          if (const auto control {simd::find_control(first, last)}; control != first)
+          {
+            derived().print(first, control);
+            first = control;
+            continue;
+          }
+        }
+
+        consume(first++);
+      }
+    }
+
+    decltype(auto) feed(const std::string_view bytes)
+    {
+      return feed(bytes.data(), bytes.data() + bytes.size());
+    }
+
+    auto state() const noexcept
+    {
+      return current;
+    }
+
+  protected:
+    void print(const char*, const char*) {}
+    void execute(char) {}
+    void esc_dispatch(std::string_view, char) {}
+    void csi_dispatch(const vt10x::parameters&, std::string_view, char) {}
+    void hook(const vt10x::parameters&, std::string_view, char) {}
+    void put(char) {}
+    void unhook() {}
+    void osc_dispatch(std::string_view) {}
+
+  private:
+    Derived& derived() noexcept
+    {
+      return static_cast<Derived&>(*this);
+    }
+
+    // Collected intermediates, or an unmatchable marker if there were too many.
+    std::string_view collected() const noexcept
+    {
+      return intermediates_size <= intermediates.size()
+               ? std::string_view {intermediates.data(), intermediates_size}
+               : std::string_view {"\x7F"};
+    }
+
+    void consume(const char* const byte)
+    {
+      const auto entry {transitions(current, static_cast<unsigned char>(*byte))};
+
+      const auto what {static_cast<action>(entry >> 4)};
+      const auto next {static_cast<vt10x::state>(entry & 0x0F)};
+
+      const auto changed {next != current or *byte == '\x1B'};
+
+      if (changed)
+      {
+        leave(current);
+      }
+
+      switch (what)
+      {
+      case action::ignore:
+        break;
+
+      case action::print:
+        derived().print(byte, byte + 1);
+        break;
+
+      case action::execute:
+        derived().execute(*byte);
+        break;
+
+      case action::collect:
+        if (intermediates_size < intermediates.size())
+        {
+          intermediates[intermediates_size] = *byte;
+        }
+        ++intermediates_size;
+        break;
+
+      case action::param:
+        param(*byte);
+        break;
+
+      case action::esc_dispatch:
+        derived().esc_dispatch(collected(), *byte);
+        break;
+
+      case action::csi_dispatch:
+        derived().csi_dispatch(parameters, collected(), *byte);
+        break;
+
+      case action::put:
+        derived().put(*byte);
+        break;
+
+      case action::osc_put:
+        if (osc_size < osc.size())
+        {
+          osc[osc_size++] = *byte;
+        }
+        break;
+      }
+
+      if (changed)
+      {
+        enter(current = next, *byte);
+      }
+    }
+
+    void param(const char byte) noexcept
+    {
+      if (parameters.size == 0)
+      {
+        parameters.size = 1;
+      }
+
+      if ('0' <= byte and byte <= '9')
+      {
+        auto& value {parameters.values[parameters.size - 1]};
+        value = std::min<std::uint32_t>(value * 10 + (byte - '0'), 0xFFFF);
+      }
+      else if (parameters.size < parameters.capacity)
+      {
+        if (byte == ':')
+        {
+          parameters.subparameters |= 1u << parameters.size;
+        }
+        parameters.values[parameters.size++] = 0;
+      }
+    }
+
+    void clear() noexcept
+    {
+      parameters.values.fill(0);
+      parameters.size = 0;
+      parameters.subparameters = 0;
+      intermediates_size = 0;
+    }
+
+    void enter(const vt10x::state next, const char byte)
+    {
+      switch (next)
+      {
+      case state::escape:
+      case state::csi_entry:
+      case state::dcs_entry:
+        clear();
+        break;
+
+      case state::dcs_passthrough:
+        derived().hook(parameters, collected(), byte);
+        break;
+
+      case state::osc_string:
+        osc_size = 0;
+        break;
+
+      default:
+        break;
+      }
+    }
+
+    void leave(const vt10x::state previous)
+    {
+      switch (previous)
+      {
+      case state::dcs_passthrough:
+        derived().unhook();
+        break;
+
+      case state::osc_string:
+        derived().osc_dispatch(std::string_view {osc.data(), osc_size});
+        break;
+
+      default:
+        break;
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_PARSER_HPP
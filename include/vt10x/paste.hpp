@@ -0,0 +1,125 @@
+#ifndef INCLUDED_VT10X_PASTE_HPP
+#define INCLUDED_VT10X_PASTE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace vt10x
+{
+  /**
+   * Text on its way to the child, written a chunk at a time as the PTY takes
+   * it rather than all at once, so that a paste of megabytes neither fills
+   * the pending input of the PTY nor keeps the loop writing. Input typed
+   * meanwhile waits behind what is queued. A paste that arrives in pieces
+   * may still be open when its queue runs dry, and is not waited for: an
+   * owner that never sends the last piece must not hold the keyboard.
+   *
+   * Newlines become carriage returns, as Return sends. Inside brackets ESC is
+   * dropped, so that pasted text cannot end the bracketed paste early.
+   */
+  class paste
+  {
+    std::string queue {};
+
+    std::size_t sent {0};
+
+    bool open {false}, bracketed {false}, carriage {false};
+
+  public:
+    static constexpr std::size_t chunk_size {4096};
+
+    auto backlog() const noexcept
+    {
+      return queue.size() - sent;
+    }
+
+    void begin(const bool bracketed)
+    {
+      if (std::exchange(open, true))
+      {
+        end();
+        open = true;
+      }
+
+      this->bracketed = bracketed;
+      carriage = false;
+
+      if (bracketed)
+      {
+        queue += "\x1B[200~";
+      }
+    }
+
+    void append(const std::string_view text)
+    {
+      for (const auto each : text)
+      {
+        if (each == '\n' and carriage)
+        {
+          carriage = false;
+          continue;
+        }
+
+        carriage = each == '\r';
+
+        if (each != '\x1B' or not bracketed)
+        {
+          queue += each == '\n' ? '\r' : each;
+        }
+      }
+    }
+
+    void end()
+    {
+      if (not std::exchange(open, false))
+      {
+        return;
+      }
+
+      if (bracketed)
+      {
+        queue += "\x1B[201~";
+      }
+    }
+
+    // Queues input behind what is not written yet; false if there is
+    // nothing, and the input may be written right away.
+    bool type(const std::string_view input)
+    {
+      if (not backlog())
+      {
+        return false;
+      }
+
+      queue.append(input);
+      return true;
+    }
+
+    // The next chunk to write, empty if there is nothing to.
+    std::string_view next() const noexcept
+    {
+      return std::string_view {queue}.substr(sent, chunk_size);
+    }
+
+    // The chunk was written.
+    void advance(const std::size_t size)
+    {
+      sent += size;
+
+      if (sent == queue.size())
+      {
+        queue.clear();
+        sent = 0;
+      }
+      else if (queue.size() < 2 * sent)
+      {
+        queue.erase(0, sent);
+        sent = 0;
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_PASTE_HPP
@@ -0,0 +1,362 @@
+#ifndef INCLUDED_VT10X_PSEUDO_TERMINAL_HPP
+#define INCLUDED_VT10X_PSEUDO_TERMINAL_HPP
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <vt10x/recording.hpp>
+
+namespace vt10x
+{
+  // Where the child starts and with what environment, if not as this process
+  // would: a window that a server opens for a client starts as the client.
+  struct launch
+  {
+    std::string directory {}; // the current one if empty
+
+    std::optional<std::vector<std::string>> environment {}; // NAME=value each
+  };
+
+  // http://man7.org/linux/man-pages/man7/pty.7.html
+  class pseudo_terminal
+  {
+    const int master;
+
+    pid_t child;
+
+    bool closed;
+
+    std::unique_ptr<char[]> buffer;
+
+    // Input the child has not accepted yet, with the lock that lets the
+    // render thread write keys while the parse thread writes replies.
+    std::string pending;
+
+    mutable std::mutex writing;
+
+    // Where output, input and sizes are recorded, if anywhere.
+    std::unique_ptr<recorder> tap;
+
+  public:
+    // One read(2) per batch. Large enough that a flood of output is consumed
+    // in a few syscalls per wakeup instead of one per line.
+    static constexpr std::size_t batch_size {64 * 1024};
+
+    explicit pseudo_terminal(const char* term, const std::size_t rows, const std::size_t columns, const launch& how = {})
+      : master {posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC)}
+      , child {-1}
+      , closed {false}
+      , buffer {new char[batch_size]}
+      , tap {}
+    {
+      if (master < 0 or grantpt(master) or unlockpt(master))
+      {
+        throw std::system_error {errno, std::generic_category(), "posix_openpt"};
+      }
+
+      char slave[64] {};
+
+      if (ptsname_r(master, slave, sizeof(slave)))
+      {
+        throw std::system_error {errno, std::generic_category(), "ptsname_r"};
+      }
+
+      resize(rows, columns);
+
+      // Made before fork(): a server forks with other threads running, and
+      // the child must not wait for a lock one of them held, e.g. of malloc.
+      auto environment {environment_of(how, term)};
+      auto shell {shell_of(environment)};
+
+      std::vector<char*> variables {};
+
+      for (auto& each : environment)
+      {
+        variables.push_back(each.data());
+      }
+
+      variables.push_back(nullptr);
+
+      char* const arguments[] {shell.data(), nullptr};
+
+      switch (child = fork())
+      {
+      case -1:
+        throw std::system_error {errno, std::generic_category(), "fork"};
+
+      case 0:
+        execute(slave, how.directory.empty() ? nullptr : how.directory.c_str(), arguments, variables.data());
+
+      default:
+        break;
+      }
+
+      if (fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK) < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "fcntl"};
+      }
+    }
+
+    pseudo_terminal(const pseudo_terminal&) = delete;
+    pseudo_terminal& operator=(const pseudo_terminal&) = delete;
+
+    ~pseudo_terminal()
+    {
+      close(master);
+
+      if (0 < child)
+      {
+        kill(child, SIGHUP);
+        waitpid(child, nullptr, WNOHANG);
+      }
+    }
+
+    auto descriptor() const noexcept
+    {
+      return master;
+    }
+
+    auto hung_up() const noexcept
+    {
+      return closed;
+    }
+
+    // Sends the child SIGHUP, as closing a terminal does; its exit then shows
+    // as a hang up of the master.
+    void hang_up() const noexcept
+    {
+      if (0 < child)
+      {
+        kill(child, SIGHUP);
+      }
+    }
+
+    // Records the session from now on, beginning with the current size; to
+    // be called before another thread uses the PTY.
+    void record(std::unique_ptr<recorder> to)
+    {
+      if (winsize size {}; to and ioctl(master, TIOCGWINSZ, &size) == 0)
+      {
+        to->resize(size.ws_row, size.ws_col);
+      }
+
+      tap = std::move(to);
+    }
+
+    /**
+     * Returns up to batch_size bytes of child output, or an empty view when
+     * nothing is left to read right now. The view is valid until next read.
+     */
+    std::string_view read()
+    {
+      for (;;)
+      {
+        if (const auto size {::read(master, buffer.get(), batch_size)}; 0 < size)
+        {
+          if (tap)
+          {
+            tap->output({buffer.get(), static_cast<std::size_t>(size)});
+          }
+
+          return {buffer.get(), static_cast<std::size_t>(size)};
+        }
+        else if (size == 0 or errno == EIO) // EIO means every slave fd has been closed
+        {
+          closed = true;
+          return {};
+        }
+        else if (errno == EAGAIN or errno == EWOULDBLOCK)
+        {
+          return {};
+        }
+        else if (errno != EINTR)
+        {
+          throw std::system_error {errno, std::generic_category(), "read"};
+        }
+      }
+    }
+
+    /**
+     * Writes input for the child without blocking. Whatever does not fit in
+     * the PTY buffer is kept, in order, until flush(); returns false in that
+     * case, so the caller can wait for EPOLLOUT.
+     */
+    bool write(const std::string_view input)
+    {
+      const std::lock_guard<std::mutex> lock {writing};
+
+      if (tap)
+      {
+        tap->input(input);
+      }
+
+      if (pending.empty())
+      {
+        const auto written {send(input)};
+        pending.append(input.substr(written));
+      }
+      else
+      {
+        pending.append(input);
+      }
+
+      return pending.empty();
+    }
+
+    // Retries the pending input; returns true once all of it is written.
+    bool flush()
+    {
+      const std::lock_guard<std::mutex> lock {writing};
+
+      pending.erase(0, send(pending));
+
+      return pending.empty();
+    }
+
+    auto blocked() const
+    {
+      const std::lock_guard<std::mutex> lock {writing};
+      return not pending.empty();
+    }
+
+    int resize(const std::size_t rows, const std::size_t columns) const noexcept
+    {
+      const winsize size {
+        static_cast<unsigned short>(rows), static_cast<unsigned short>(columns), 0, 0
+      };
+
+      if (tap)
+      {
+        tap->resize(rows, columns);
+      }
+
+      return ioctl(master, TIOCSWINSZ, &size);
+    }
+
+  private:
+    // Number of bytes of input the child accepted.
+    std::size_t send(const std::string_view input)
+    {
+      std::size_t written {0};
+
+      while (written < input.size())
+      {
+        if (const auto size {::write(master, input.data() + written, input.size() - written)}; 0 <= size)
+        {
+          written += size;
+        }
+        else if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EIO) // read() notices the hangup
+        {
+          break;
+        }
+        else if (errno != EINTR)
+        {
+          throw std::system_error {errno, std::generic_category(), "write"};
+        }
+      }
+
+      return written;
+    }
+
+    // The environment of how, else of this process, with TERM set to term.
+    static std::vector<std::string> environment_of(const launch& how, const char* const term)
+    {
+      std::vector<std::string> environment {};
+
+      const auto keep = [&](const std::string_view each)
+      {
+        if (each.compare(0, 5, "TERM=") != 0)
+        {
+          environment.emplace_back(each);
+        }
+      };
+
+      if (how.environment)
+      {
+        for (const auto& each : *how.environment)
+        {
+          keep(each);
+        }
+      }
+      else
+      {
+        for (auto* each {environ}; each and *each; ++each)
+        {
+          keep(*each);
+        }
+      }
+
+      environment.push_back(std::string {"TERM="} + term);
+
+      return environment;
+    }
+
+    // The SHELL of environment, else the login shell of the user.
+    static std::string shell_of(const std::vector<std::string>& environment)
+    {
+      for (const auto& each : environment)
+      {
+        if (each.compare(0, 6, "SHELL=") == 0 and 6 < each.size())
+        {
+          return each.substr(6);
+        }
+      }
+
+      const auto* entry {getpwuid(getuid())};
+
+      return entry and entry->pw_shell and *entry->pw_shell ? entry->pw_shell : "/bin/sh";
+    }
+
+    // Only async-signal-safe calls from here on, see the constructor.
+    [[noreturn]] static void execute(const char* slave, const char* directory, char* const arguments[], char* const environment[]) noexcept
+    {
+      setsid();
+
+      // The mask survives exec, and the parent blocks signals it reads from a
+      // signalfd.
+      sigset_t signals;
+      sigemptyset(&signals);
+      sigprocmask(SIG_SETMASK, &signals, nullptr);
+
+      if (const auto fd {open(slave, O_RDWR)}; 0 <= fd)
+      {
+        ioctl(fd, TIOCSCTTY, 0);
+
+        dup2(fd, STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+
+        if (STDERR_FILENO < fd)
+        {
+          close(fd);
+        }
+      }
+
+      // A directory gone meanwhile leaves the child where the parent is.
+      if (directory)
+      {
+        static_cast<void>(chdir(directory));
+      }
+
+      execve(arguments[0], arguments, environment);
+      _exit(127);
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_PSEUDO_TERMINAL_HPP
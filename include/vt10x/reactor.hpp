@@ -0,0 +1,86 @@
+#ifndef INCLUDED_VT10X_REACTOR_HPP
+#define INCLUDED_VT10X_REACTOR_HPP
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace vt10x
+{
+  // http://man7.org/linux/man-pages/man7/epoll.7.html
+  class reactor
+  {
+    const int descriptor;
+
+    std::array<epoll_event, 16> events;
+
+  public:
+    explicit reactor()
+      : descriptor {epoll_create1(EPOLL_CLOEXEC)}
+    {
+      if (descriptor < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "epoll_create1"};
+      }
+    }
+
+    reactor(const reactor&) = delete;
+    reactor& operator=(const reactor&) = delete;
+
+    ~reactor()
+    {
+      close(descriptor);
+    }
+
+    void watch(const int fd, const std::uint64_t token, const std::uint32_t flags = EPOLLIN)
+    {
+      epoll_event event {flags, {}};
+      event.data.u64 = token;
+
+      if (epoll_ctl(descriptor, EPOLL_CTL_ADD, fd, &event) < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "epoll_ctl"};
+      }
+    }
+
+    void modify(const int fd, const std::uint64_t token, const std::uint32_t flags)
+    {
+      epoll_event event {flags, {}};
+      event.data.u64 = token;
+
+      if (epoll_ctl(descriptor, EPOLL_CTL_MOD, fd, &event) < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "epoll_ctl"};
+      }
+    }
+
+    /**
+     * Blocks until at least one watched descriptor is ready or timeout (in
+     * milliseconds, -1 for infinity) expires, then calls f(token, flags) for
+     * each of them. Returns the number of ready descriptors.
+     */
+    template <typename F>
+    auto wait(const int timeout, F&& f)
+    {
+      const auto size {epoll_wait(descriptor, events.data(), events.size(), timeout)};
+
+      if (size < 0 and errno != EINTR)
+      {
+        throw std::system_error {errno, std::generic_category(), "epoll_wait"};
+      }
+
+      for (auto index {0}; index < size; ++index)
+      {
+        f(events[index].data.u64, events[index].events);
+      }
+
+      return size < 0 ? 0 : size;
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_REACTOR_HPP
@@ -0,0 +1,419 @@
+#ifndef INCLUDED_VT10X_RECORDING_HPP
+#define INCLUDED_VT10X_RECORDING_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace vt10x
+{
+  /**
+   * A session as the PTY saw it, for replaying real workloads through the
+   * parser, the grid and the renderer, e.g. by the benchmark. The file is
+   * made to be mapped, in the byte order of the machine that wrote it:
+   *
+   *   header   "vt10xrec", version (u32), 0 (u32)
+   *   event    nanoseconds since the start (u64), size (u32), kind (u32),
+   *            size bytes of data, zeros up to a multiple of 8
+   *   ...
+   *   index    offset of each event (u64)
+   *   trailer  number of events (u64), offset of the index (u64), "vt10xidx"
+   *
+   * The index is written when the recording ends; a file without one, e.g.
+   * of a session that crashed, is read up to its last whole event.
+   */
+  namespace recording_format
+  {
+    inline constexpr char magic[8] {'v', 't', '1', '0', 'x', 'r', 'e', 'c'}, index_magic[8] {'v', 't', '1', '0', 'x', 'i', 'd', 'x'};
+
+    inline constexpr std::uint32_t version {1};
+
+    enum kind : std::uint32_t
+    {
+      output, // read from the child
+      input,  // written to the child: keys, pastes and replies
+      resize, // the child was told of a size: rows, columns (u32 each)
+    };
+
+    struct header
+    {
+      char magic[8];
+      std::uint32_t version, reserved;
+    };
+
+    struct event
+    {
+      std::uint64_t time;
+      std::uint32_t size, kind;
+    };
+
+    struct trailer
+    {
+      std::uint64_t count, index;
+      char magic[8];
+    };
+
+    constexpr std::size_t padded(const std::size_t size) noexcept
+    {
+      return (size + 7) & ~std::size_t {7};
+    }
+  } // namespace recording_format
+
+  /**
+   * Writes a recording, from any thread. Recording is best effort, like the
+   * history: once a write fails the recorder stops, never the session.
+   */
+  class recorder
+  {
+    int file;
+
+    const std::chrono::steady_clock::time_point started {std::chrono::steady_clock::now()};
+
+    std::uint64_t end {0};
+
+    std::vector<std::uint64_t> offsets {};
+
+    std::mutex guard {};
+
+  public:
+    explicit recorder(const std::string& path)
+      : file {::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)}
+    {
+      if (file < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "open"};
+      }
+
+      recording_format::header header {};
+      std::memcpy(header.magic, recording_format::magic, sizeof(header.magic));
+      header.version = recording_format::version;
+
+      write({{&header, sizeof(header)}});
+    }
+
+    recorder(const recorder&) = delete;
+    recorder& operator=(const recorder&) = delete;
+
+    ~recorder()
+    {
+      if (file < 0)
+      {
+        return;
+      }
+
+      recording_format::trailer trailer {offsets.size(), end, {}};
+      std::memcpy(trailer.magic, recording_format::index_magic, sizeof(trailer.magic));
+
+      write({{offsets.data(), offsets.size() * sizeof(std::uint64_t)}, {&trailer, sizeof(trailer)}});
+
+      if (0 <= file)
+      {
+        close(file);
+      }
+    }
+
+    void output(const std::string_view data) noexcept
+    {
+      append(recording_format::output, data);
+    }
+
+    void input(const std::string_view data) noexcept
+    {
+      append(recording_format::input, data);
+    }
+
+    void resize(const std::size_t rows, const std::size_t columns) noexcept
+    {
+      const std::uint32_t size[] {static_cast<std::uint32_t>(rows), static_cast<std::uint32_t>(columns)};
+      append(recording_format::resize, std::string_view {reinterpret_cast<const char*>(size), sizeof(size)});
+    }
+
+  private:
+    void append(const recording_format::kind kind, const std::string_view data) noexcept
+    {
+      static constexpr char zeros[8] {};
+
+      const std::lock_guard<std::mutex> lock {guard};
+
+      if (file < 0)
+      {
+        return;
+      }
+
+      const recording_format::event event {
+        static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count()),
+        static_cast<std::uint32_t>(data.size()),
+        kind
+      };
+
+      try
+      {
+        offsets.push_back(end);
+      }
+      catch (...)
+      {
+        stop();
+        return;
+      }
+
+      write({{&event, sizeof(event)}, {data.data(), data.size()}, {zeros, recording_format::padded(data.size()) - data.size()}});
+    }
+
+    // Writes the pieces at the end, or stops recording.
+    void write(std::initializer_list<std::pair<const void*, std::size_t>> pieces) noexcept
+    {
+      iovec vectors[3] {};
+      int count {0};
+
+      for (const auto& [base, size] : pieces)
+      {
+        vectors[count++] = iovec {const_cast<void*>(base), size};
+      }
+
+      for (int first {0}; first < count; )
+      {
+        const auto size {writev(file, vectors + first, count - first)};
+
+        if (size < 0)
+        {
+          if (errno == EINTR)
+          {
+            continue;
+          }
+
+          stop();
+          return;
+        }
+
+        end += static_cast<std::uint64_t>(size);
+
+        auto left {static_cast<std::size_t>(size)};
+
+        for (; first < count and vectors[first].iov_len <= left; ++first)
+        {
+          left -= vectors[first].iov_len;
+        }
+
+        if (first < count)
+        {
+          vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + left;
+          vectors[first].iov_len -= left;
+        }
+      }
+    }
+
+    void stop() noexcept
+    {
+      close(file);
+      file = -1;
+    }
+  };
+
+  /**
+   * A recording mapped for reading, as a sequence of events.
+   */
+  class recording
+  {
+  public:
+    struct event
+    {
+      std::chrono::nanoseconds time; // since the recording started
+
+      recording_format::kind kind;
+
+      std::string_view data;
+
+      // Of a resize.
+      std::pair<std::size_t, std::size_t> size() const noexcept
+      {
+        std::uint32_t values[2] {};
+        std::memcpy(values, data.data(), std::min(data.size(), sizeof(values)));
+        return {values[0], values[1]};
+      }
+    };
+
+  private:
+    const char* map {nullptr};
+
+    std::size_t mapped {0};
+
+    const std::uint64_t* index {nullptr};
+
+    std::vector<std::uint64_t> scanned {}; // the index, where the file has none
+
+    std::size_t count {0};
+
+  public:
+    // True if the file at path starts like a recording.
+    static bool is(const std::string& path) noexcept
+    {
+      char magic[sizeof(recording_format::magic)] {};
+
+      const auto file {::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+      if (file < 0)
+      {
+        return false;
+      }
+
+      const auto read {::read(file, magic, sizeof(magic))};
+      close(file);
+
+      return read == sizeof(magic) and std::memcmp(magic, recording_format::magic, sizeof(magic)) == 0;
+    }
+
+    explicit recording(const std::string& path)
+    {
+      const auto file {::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+      if (file < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "open"};
+      }
+
+      struct stat status {};
+
+      if (fstat(file, &status) < 0 or static_cast<std::size_t>(status.st_size) < sizeof(recording_format::header))
+      {
+        close(file);
+        throw std::runtime_error {"not a recording: " + path};
+      }
+
+      auto* const pointer {mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0)};
+      close(file);
+
+      if (pointer == MAP_FAILED)
+      {
+        throw std::system_error {errno, std::generic_category(), "mmap"};
+      }
+
+      map = static_cast<const char*>(pointer);
+      mapped = static_cast<std::size_t>(status.st_size);
+
+      recording_format::header header {};
+      std::memcpy(&header, map, sizeof(header));
+
+      if (std::memcmp(header.magic, recording_format::magic, sizeof(header.magic)) or header.version != recording_format::version)
+      {
+        munmap(const_cast<char*>(map), mapped);
+        throw std::runtime_error {"not a recording of this version: " + path};
+      }
+
+      if (not indexed())
+      {
+        scan();
+      }
+    }
+
+    recording(const recording&) = delete;
+    recording& operator=(const recording&) = delete;
+
+    ~recording()
+    {
+      munmap(const_cast<char*>(map), mapped);
+    }
+
+    auto size() const noexcept
+    {
+      return count;
+    }
+
+    event operator[](const std::size_t number) const noexcept
+    {
+      recording_format::event header {};
+      std::memcpy(&header, map + index[number], sizeof(header));
+
+      return {
+        std::chrono::nanoseconds {header.time},
+        static_cast<recording_format::kind>(header.kind),
+        std::string_view {map + index[number] + sizeof(header), header.size}
+      };
+    }
+
+  private:
+    // Takes the index of the file if it has a sound one.
+    bool indexed() noexcept
+    {
+      if (mapped < sizeof(recording_format::header) + sizeof(recording_format::trailer))
+      {
+        return false;
+      }
+
+      recording_format::trailer trailer {};
+      std::memcpy(&trailer, map + mapped - sizeof(trailer), sizeof(trailer));
+
+      const auto index_end {mapped - sizeof(trailer)};
+
+      if (std::memcmp(trailer.magic, recording_format::index_magic, sizeof(trailer.magic))
+          or trailer.index % 8 or index_end < trailer.index or (index_end - trailer.index) / 8 != trailer.count)
+      {
+        return false;
+      }
+
+      for (std::size_t each {0}; each < trailer.count; ++each)
+      {
+        std::uint64_t offset;
+        std::memcpy(&offset, map + trailer.index + each * 8, sizeof(offset));
+
+        if (not whole(offset, trailer.index))
+        {
+          return false;
+        }
+      }
+
+      index = reinterpret_cast<const std::uint64_t*>(map + trailer.index);
+      count = trailer.count;
+      return true;
+    }
+
+    // Indexes the events from the start, up to the last whole one.
+    void scan()
+    {
+      for (std::uint64_t offset {sizeof(recording_format::header)}; whole(offset, mapped); )
+      {
+        scanned.push_back(offset);
+
+        recording_format::event header {};
+        std::memcpy(&header, map + offset, sizeof(header));
+
+        offset += sizeof(header) + recording_format::padded(header.size);
+      }
+
+      index = scanned.data();
+      count = scanned.size();
+    }
+
+    // True if an event starts at offset and ends before limit.
+    bool whole(const std::uint64_t offset, const std::uint64_t limit) const noexcept
+    {
+      if (limit < sizeof(recording_format::event) or limit - sizeof(recording_format::event) < offset)
+      {
+        return false;
+      }
+
+      recording_format::event header {};
+      std::memcpy(&header, map + offset, sizeof(header));
+
+      return header.kind <= recording_format::resize and header.size <= limit - offset - sizeof(header);
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_RECORDING_HPP
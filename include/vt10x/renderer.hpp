@@ -0,0 +1,515 @@
+#ifndef INCLUDED_VT10X_RENDERER_HPP
+#define INCLUDED_VT10X_RENDERER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <cairo/cairo.h>
+
+#include <vt10x/atlas.hpp>
+#include <vt10x/attribute.hpp>
+#include <vt10x/screen.hpp>
+#include <vt10x/selection.hpp>
+#include <vt10x/utf8.hpp>
+
+namespace vt10x
+{
+  /**
+   * Subset of the fontconfig pattern syntax, as the global font string:
+   * "Monospace:pixelsize=14:antialias=true:autohint=true".
+   */
+  struct font_description
+  {
+    std::string family {"Monospace"};
+
+    double size {14};
+
+    bool antialias {true}, autohint {false};
+
+    explicit font_description(const std::string_view pattern)
+    {
+      auto rest {pattern};
+
+      family = std::string {rest.substr(0, rest.find(':'))};
+
+      while (rest.find(':') != std::string_view::npos)
+      {
+        rest.remove_prefix(rest.find(':') + 1);
+
+        const auto property {rest.substr(0, rest.find(':'))};
+        const auto key {property.substr(0, property.find('='))};
+        const auto value {property.substr(std::min(property.size(), key.size() + 1))};
+
+        if (key == "pixelsize" or key == "size")
+        {
+          size = std::stod(std::string {value});
+        }
+        else if (key == "antialias")
+        {
+          antialias = value == "true";
+        }
+        else if (key == "autohint")
+        {
+          autohint = value == "true";
+        }
+      }
+    }
+  };
+
+  struct rgb
+  {
+    double r, g, b;
+
+    static constexpr rgb from(const std::uint32_t value) noexcept
+    {
+      return {(value >> 16 & 0xFF) / 255.0, (value >> 8 & 0xFF) / 255.0, (value & 0xFF) / 255.0};
+    }
+  };
+
+  // xterm's default 256-color palette.
+  constexpr auto make_palette()
+  {
+    std::array<std::uint32_t, 256> palette {
+      0x000000, 0xCD0000, 0x00CD00, 0xCDCD00, 0x0000EE, 0xCD00CD, 0x00CDCD, 0xE5E5E5,
+      0x7F7F7F, 0xFF0000, 0x00FF00, 0xFFFF00, 0x5C5CFF, 0xFF00FF, 0x00FFFF, 0xFFFFFF,
+    };
+
+    constexpr std::uint32_t levels[] {0x00, 0x5F, 0x87, 0xAF, 0xD7, 0xFF};
+
+    for (auto index {0u}; index < 216; ++index)
+    {
+      palette[16 + index] = levels[index / 36] << 16 | levels[index / 6 % 6] << 8 | levels[index % 6];
+    }
+
+    for (auto index {0u}; index < 24; ++index)
+    {
+      const auto level {8 + index * 10};
+      palette[232 + index] = level << 16 | level << 8 | level;
+    }
+
+    return palette;
+  }
+
+  inline constexpr auto palette {make_palette()};
+
+  // Rectangle in window coordinates.
+  struct box
+  {
+    double x, y, width, height;
+
+    constexpr auto empty() const noexcept
+    {
+      return not (0 < width and 0 < height);
+    }
+  };
+
+  /**
+   * Draws a screen with cairo. Only damaged spans are redrawn: the context is
+   * clipped to their rectangles, so a one-cell change costs one cell worth of
+   * rasterization however large the window is. Glyphs are rasterized once
+   * into an atlas and masked from there; copies of a renderer share it.
+   */
+  class renderer
+  {
+    const font_description font;
+
+    std::unique_ptr<cairo_font_options_t, decltype(&cairo_font_options_destroy)> options;
+
+    vt10x::cursor drawn {0, 0, 0, false, false}; // where the cursor was drawn last
+
+    std::optional<selection::region> marked {}; // shaded as selected, see mark()
+
+    bool clear {true}; // the area outside the grid needs to be painted
+
+  public:
+    std::uint32_t foreground {0xE5E5E5}, background {0x000000};
+
+    double cell_width {0}, cell_height {0}, ascent {0};
+
+    explicit renderer(const std::string_view pattern)
+      : font {pattern}
+      , options {make_options(font)}
+      , atlas {measure()}
+    {
+      // Printable ASCII is most of what any screen shows.
+      for (char32_t codepoint {0x21}; codepoint < 0x7F; ++codepoint)
+      {
+        glyph(codepoint, 0);
+      }
+    }
+
+    // Draws another target with the glyphs (and their cost) of other, which
+    // is how every window of a server shares one atlas.
+    renderer(const renderer& other)
+      : font {other.font}
+      , options {make_options(font)}
+      , foreground {other.foreground}
+      , background {other.background}
+      , cell_width {other.cell_width}
+      , cell_height {other.cell_height}
+      , ascent {other.ascent}
+      , atlas {other.atlas}
+    {}
+
+    // Position of the glyph in the atlas, rasterizing it on a miss.
+    glyph_atlas::position glyph(const char32_t codepoint, const std::uint16_t style)
+    {
+      return atlas->find(glyph_atlas::key(codepoint, style), [&](cairo_t* const context, auto x, auto y)
+      {
+        char text[5] {};
+        auto* end {text};
+        encode_utf8(codepoint, end);
+
+        select(context, style);
+        cairo_move_to(context, x, y + ascent);
+        cairo_show_text(context, text);
+      });
+    }
+
+    const glyph_atlas& glyphs() const noexcept
+    {
+      return *atlas;
+    }
+
+    void select(cairo_t* const context, const std::uint16_t style) const
+    {
+      cairo_select_font_face(
+        context,
+        font.family.c_str(),
+        style & attribute::italic ? CAIRO_FONT_SLANT_ITALIC : CAIRO_FONT_SLANT_NORMAL,
+        style & attribute::bold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL
+      );
+      cairo_set_font_size(context, font.size);
+      cairo_set_font_options(context, options.get());
+    }
+
+    std::uint32_t resolve(const std::uint32_t value, const std::uint32_t fallback) const noexcept
+    {
+      switch (color::kind(value))
+      {
+      case color::palette:
+        return palette[value & 0xFF];
+
+      case color::rgb:
+        return value & 0xFFFFFF;
+
+      default:
+        return fallback;
+      }
+    }
+
+    // Foreground and background of a cell after bold brightening and inverse.
+    auto colors(const attribute& rendition) const noexcept
+    {
+      auto fore {rendition.foreground};
+
+      if (rendition.style & attribute::bold and color::kind(fore) == color::palette and (fore & 0xFF) < 8)
+      {
+        fore += 8;
+      }
+
+      auto pair {std::make_pair(resolve(fore, foreground), resolve(rendition.background, background))};
+
+      if (rendition.style & attribute::inverse)
+      {
+        std::swap(pair.first, pair.second);
+      }
+
+      if (rendition.style & attribute::invisible)
+      {
+        pair.first = pair.second;
+      }
+
+      return pair;
+    }
+
+    // Marks the cells under a window rectangle (e.g. of an expose) damaged.
+    void expose(screen& screen, const double x, const double y, const double width, const double height) noexcept
+    {
+      if (screen.columns() * cell_width < x + width or screen.rows() * cell_height < y + height)
+      {
+        clear = true;
+      }
+
+      const auto first_row {static_cast<std::size_t>(y / cell_height)};
+      const auto last_row {std::min(screen.rows(), static_cast<std::size_t>(std::ceil((y + height) / cell_height)))};
+
+      const auto first_column {static_cast<std::size_t>(x / cell_width)};
+      const auto last_column {static_cast<std::size_t>(std::ceil((x + width) / cell_width))};
+
+      for (auto row {first_row}; row < last_row; ++row)
+      {
+        screen.damage(row, first_column, last_column);
+      }
+    }
+
+    // Shades region as selected, or nothing; the cells of both the region
+    // and the one before are redrawn.
+    void mark(screen& screen, const std::optional<selection::region>& region) noexcept
+    {
+      for (const auto* each : {&std::as_const(marked), &region})
+      {
+        for (auto row {*each ? (*each)->first.row : screen.rows()}; row < screen.rows() and row <= (*each)->last.row; ++row)
+        {
+          const auto columns {(*each)->columns(row, screen.columns())};
+          screen.damage(row, columns.first, columns.last);
+        }
+      }
+
+      marked = region;
+    }
+
+    const auto& marks() const noexcept
+    {
+      return marked;
+    }
+
+    // The next render paints the whole target, e.g. after it was reallocated.
+    void invalidate() noexcept
+    {
+      clear = true;
+    }
+
+    /**
+     * Redraws the damaged spans of the screen onto target and repairs them.
+     * Returns the bounding box of what was drawn, empty if nothing was.
+     */
+    box render(cairo_surface_t* const target, screen& screen)
+    {
+      // The cursor is drawn over the cells, so both where it was and where it
+      // is now have to be redrawn when it moves.
+      if (drawn.row != screen.cursor.row or drawn.column != screen.cursor.column or drawn.visible != screen.cursor.visible)
+      {
+        if (drawn.row < screen.rows())
+        {
+          screen.damage(drawn.row, drawn.column, drawn.column + 1);
+        }
+
+        screen.damage(screen.cursor.row, screen.cursor.column, screen.cursor.column + 1);
+      }
+
+      if (not screen.damaged() and not clear)
+      {
+        return {0, 0, 0, 0};
+      }
+
+      const std::unique_ptr<cairo_t, decltype(&cairo_destroy)> context {cairo_create(target), cairo_destroy};
+
+      const auto cleared {std::exchange(clear, false)};
+
+      // All of the target, margins past the last whole cell included.
+      box painted {0, 0, 0, 0};
+
+      if (cleared)
+      {
+        double x1, y1, x2, y2;
+        cairo_clip_extents(context.get(), &x1, &y1, &x2, &y2);
+        painted = {x1, y1, x2 - x1, y2 - y1};
+
+        cairo_set_operator(context.get(), CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_rgb(context.get(), rgb::from(background).r, rgb::from(background).g, rgb::from(background).b);
+        cairo_paint(context.get());
+        screen.damage_all();
+      }
+
+      std::size_t top {screen.rows()}, bottom {0}, left {screen.columns()}, right {0};
+
+      for (std::size_t row {0}; row < screen.rows(); ++row)
+      {
+        if (const auto damage {widen(screen, row)}; not damage.empty())
+        {
+          cairo_rectangle(context.get(), damage.first * cell_width, row * cell_height, (damage.last - damage.first) * cell_width, cell_height);
+
+          top = std::min(top, row);
+          bottom = row + 1;
+          left = std::min<std::size_t>(left, damage.first);
+          right = std::max<std::size_t>(right, damage.last);
+        }
+      }
+
+      cairo_clip(context.get());
+
+      for (std::size_t row {0}; row < screen.rows(); ++row)
+      {
+        if (const auto damage {widen(screen, row)}; not damage.empty())
+        {
+          draw(context.get(), screen, row, damage);
+        }
+      }
+
+      // Drawn over every damaged row it covers, as those were painted anew.
+      if (marked)
+      {
+        cairo_set_operator(context.get(), CAIRO_OPERATOR_OVER);
+        cairo_set_source_rgba(context.get(), rgb::from(foreground).r, rgb::from(foreground).g, rgb::from(foreground).b, 0.3);
+
+        for (auto row {marked->first.row}; row <= marked->last.row and row < screen.rows(); ++row)
+        {
+          const auto columns {marked->columns(row, screen.columns())};
+          cairo_rectangle(context.get(), columns.first * cell_width, row * cell_height, (columns.last - columns.first) * cell_width, cell_height);
+        }
+
+        cairo_fill(context.get());
+      }
+
+      if (screen.cursor.visible)
+      {
+        const auto x {screen.cursor.column * cell_width}, y {screen.cursor.row * cell_height};
+
+        cairo_set_operator(context.get(), CAIRO_OPERATOR_OVER);
+        cairo_set_source_rgba(context.get(), rgb::from(foreground).r, rgb::from(foreground).g, rgb::from(foreground).b, 0.5);
+        cairo_rectangle(context.get(), x, y, cell_width, cell_height);
+        cairo_fill(context.get());
+      }
+
+      drawn = screen.cursor;
+
+      screen.repair();
+
+      if (cleared)
+      {
+        return painted;
+      }
+
+      return {left * cell_width, top * cell_height, (right - left) * cell_width, (bottom - top) * cell_height};
+    }
+
+  private:
+    std::shared_ptr<glyph_atlas> atlas;
+
+    static decltype(options) make_options(const font_description& font)
+    {
+      decltype(options) options {cairo_font_options_create(), cairo_font_options_destroy};
+
+      cairo_font_options_set_antialias(options.get(), font.antialias ? CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
+      cairo_font_options_set_hint_style(options.get(), font.autohint ? CAIRO_HINT_STYLE_SLIGHT : CAIRO_HINT_STYLE_DEFAULT);
+
+      return options;
+    }
+
+    // Sets the cell metrics and returns the atlas they call for: slots are two
+    // cells wide to fit double width glyphs.
+    std::shared_ptr<glyph_atlas> measure()
+    {
+      // Metrics do not depend on the target, so any scratch surface will do.
+      const std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> scratch {
+        cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1), cairo_surface_destroy
+      };
+
+      const std::unique_ptr<cairo_t, decltype(&cairo_destroy)> context {cairo_create(scratch.get()), cairo_destroy};
+
+      select(context.get(), 0);
+
+      cairo_font_extents_t extents {};
+      cairo_font_extents(context.get(), &extents);
+
+      cell_width = std::ceil(extents.max_x_advance);
+      cell_height = std::ceil(extents.height);
+      ascent = std::ceil(extents.ascent);
+
+      return std::make_shared<glyph_atlas>(static_cast<int>(cell_width) * 2, static_cast<int>(cell_height));
+    }
+
+    // Extends a damaged span so that it never cuts a double width character.
+    static span widen(const screen& screen, const std::size_t row) noexcept
+    {
+      auto damage {screen.damage(row)};
+
+      if (not damage.empty())
+      {
+        if (0 < damage.first and screen(row, damage.first).flags & cell::wide_spacer)
+        {
+          --damage.first;
+        }
+
+        if (damage.last < screen.columns() and screen(row, damage.last - 1).flags & cell::wide)
+        {
+          ++damage.last;
+        }
+      }
+
+      return damage;
+    }
+
+    // Draws the damaged columns of a row a run of cells of one attribute at a
+    // time: the background and each line across the run in one rectangle,
+    // the glyphs one by one, each clipped to its cell.
+    void draw(cairo_t* const context, const screen& screen, const std::size_t row, const span damage)
+    {
+      const auto* const cells {screen.line(row)};
+
+      const auto y {row * cell_height};
+
+      for (auto first {damage.first}; first < damage.last; )
+      {
+        const auto index {cells[first].attribute};
+
+        // The right half of a double width character goes with its left one.
+        auto last {first + 1};
+
+        for (; last < damage.last and (cells[last].attribute == index or cells[last].flags & cell::wide_spacer); ++last);
+
+        const auto& rendition {screen.attributes[index]};
+
+        const auto [fore, back] {colors(rendition)};
+
+        const auto x {first * cell_width};
+        const auto width {(last - first) * cell_width};
+
+        cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_rgb(context, rgb::from(back).r, rgb::from(back).g, rgb::from(back).b);
+        cairo_rectangle(context, x, y, width, cell_height);
+        cairo_fill(context);
+
+        cairo_set_source_rgb(context, rgb::from(fore).r, rgb::from(fore).g, rgb::from(fore).b);
+
+        for (auto column {first}; fore != back and column < last; ++column)
+        {
+          const auto& cell {cells[column]};
+
+          if (cell.codepoint == U' ' or cell.flags & cell::wide_spacer)
+          {
+            continue;
+          }
+
+          const auto at {glyph(cell.codepoint, rendition.style)};
+
+          const auto left {column * cell_width};
+
+          cairo_save(context);
+          cairo_rectangle(context, left, y, cell.flags & cell::wide ? cell_width * 2 : cell_width, cell_height);
+          cairo_clip(context);
+          cairo_set_operator(context, CAIRO_OPERATOR_OVER);
+          cairo_mask_surface(context, atlas->surface(), left - at.x, y - at.y);
+          cairo_restore(context);
+        }
+
+        if (rendition.style & (attribute::underline | attribute::strike))
+        {
+          if (rendition.style & attribute::underline)
+          {
+            cairo_rectangle(context, x, y + ascent + 1, width, 1);
+          }
+
+          if (rendition.style & attribute::strike)
+          {
+            cairo_rectangle(context, x, y + std::round(ascent / 2), width, 1);
+          }
+
+          cairo_fill(context);
+        }
+
+        first = last;
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_RENDERER_HPP
@@ -0,0 +1,691 @@
+#ifndef INCLUDED_VT10X_SCREEN_HPP
+#define INCLUDED_VT10X_SCREEN_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <vt10x/attribute.hpp>
+#include <vt10x/cell.hpp>
+#include <vt10x/scrollback.hpp>
+
+namespace vt10x
+{
+  struct cursor
+  {
+    std::size_t row, column;
+
+    std::uint16_t attribute;
+
+    bool pending_wrap; // written to the last column with autowrap enabled
+
+    bool visible;
+  };
+
+  // Columns [first, last) of a row; empty if first == last.
+  struct span
+  {
+    std::uint32_t first, last;
+
+    auto empty() const noexcept
+    {
+      return last <= first;
+    }
+  };
+
+  /**
+   * Row-major cell grid. Rows are addressed through a ring of line offsets,
+   * so scrolling the whole screen rotates the ring origin instead of moving
+   * cells, and scrolling a region only permutes its offsets.
+   *
+   * Every write records the span of columns it touched in the damage of its
+   * row, so that the renderer only redraws what changed since repair().
+   *
+   * Resizing builds the new grid in the buffer of the one before and swaps
+   * them, so a drag that resizes many times allocates only while it grows
+   * beyond the largest size so far.
+   */
+  class screen
+  {
+    std::size_t rows_, columns_;
+
+    std::vector<cell> cells;
+
+    std::vector<cell> spare; // the previous cells, whose capacity resizes reuse
+
+    std::vector<std::uint32_t> lines; // physical offset of each ring position
+
+    std::size_t origin; // ring position of the logical row 0
+
+    std::vector<span> damages; // indexed by logical row
+
+    bool damaged_;
+
+    std::size_t compact_at; // size of attributes that calls for compact()
+
+    attribute_table kept; // the table compact() fills, that of the one before
+
+    std::vector<std::uint32_t> remapped; // by compact(), new indices plus 1
+
+  public:
+    static constexpr std::size_t default_rows {24}, default_columns {80};
+
+    vt10x::cursor cursor;
+
+    attribute_table attributes;
+
+    std::size_t top, bottom; // scrolling region [top, bottom)
+
+    bool autowrap;
+
+    // Where lines scrolled off the top go, if anywhere: only the primary
+    // screen of a terminal keeps them.
+    scrollback* history;
+
+    explicit screen(const std::size_t rows = default_rows, const std::size_t columns = default_columns)
+      : rows_ {0}
+      , columns_ {0}
+      , origin {0}
+      , damages {}
+      , damaged_ {false}
+      , compact_at {4096}
+      , kept {}
+      , remapped {}
+      , cursor {0, 0, 0, false, true}
+      , attributes {}
+      , top {0}
+      , bottom {0}
+      , autowrap {true}
+      , history {nullptr}
+    {
+      resize(rows, columns);
+    }
+
+    auto rows() const noexcept
+    {
+      return rows_;
+    }
+
+    auto columns() const noexcept
+    {
+      return columns_;
+    }
+
+    auto blank() const noexcept
+    {
+      return cell {U' ', cursor.attribute, 0};
+    }
+
+    cell* line(const std::size_t row) noexcept
+    {
+      return cells.data() + lines[(origin + row) % rows_];
+    }
+
+    const cell* line(const std::size_t row) const noexcept
+    {
+      return cells.data() + lines[(origin + row) % rows_];
+    }
+
+    decltype(auto) operator()(const std::size_t row, const std::size_t column) noexcept
+    {
+      return line(row)[column];
+    }
+
+    decltype(auto) operator()(const std::size_t row, const std::size_t column) const noexcept
+    {
+      return line(row)[column];
+    }
+
+    auto damaged() const noexcept
+    {
+      return damaged_;
+    }
+
+    auto damage(const std::size_t row) const noexcept
+    {
+      return damages[row];
+    }
+
+    void damage(const std::size_t row, const std::size_t first, const std::size_t last) noexcept
+    {
+      if (first < last)
+      {
+        auto& damage {damages[row]};
+
+        if (damage.empty())
+        {
+          damage = span {static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(std::min(last, columns_))};
+        }
+        else
+        {
+          damage.first = std::min(damage.first, static_cast<std::uint32_t>(first));
+          damage.last = std::max(damage.last, static_cast<std::uint32_t>(std::min(last, columns_)));
+        }
+
+        damaged_ = true;
+      }
+    }
+
+    void damage_all() noexcept
+    {
+      for (std::size_t row {0}; row < rows_; ++row)
+      {
+        damages[row] = span {0, static_cast<std::uint32_t>(columns_)};
+      }
+
+      damaged_ = true;
+    }
+
+    // Forgets the damage after it has been rendered.
+    void repair() noexcept
+    {
+      std::fill(std::begin(damages), std::end(damages), span {0, 0});
+      damaged_ = false;
+    }
+
+    /**
+     * The index of value in attributes, for the pen. Attributes no cell uses
+     * any longer are let go once the table has grown to twice what it kept
+     * the last time, so that output cycling through RGB colors neither runs
+     * out of indices nor makes the snapshots copy stale ones.
+     */
+    std::uint16_t intern(const attribute& value)
+    {
+      if (compact_at <= attributes.size())
+      {
+        compact();
+      }
+
+      return attributes.intern(value);
+    }
+
+    // Truncates or pads every row, as the alternate screen is resized.
+    void resize(const std::size_t rows, const std::size_t columns)
+    {
+      spare.assign(rows * columns, cell {U' ', 0, 0});
+
+      for (std::size_t row {0}; row < std::min(rows, rows_); ++row)
+      {
+        std::copy_n(line(row), std::min(columns, columns_), spare.data() + row * columns);
+      }
+
+      cursor.row = std::min(cursor.row, rows - 1);
+      cursor.column = std::min(cursor.column, columns - 1);
+      cursor.pending_wrap = false;
+
+      adopt(rows, columns);
+    }
+
+    /**
+     * Resizes rewrapping the lines that autowrap continued, as the primary
+     * screen is resized. The cursor stays on its character. When the lines no
+     * longer fit, blank rows below the cursor are dropped first, then rows
+     * from the top, into the history.
+     */
+    void reflow(const std::size_t rows, const std::size_t columns)
+    {
+      if (rows == rows_ and columns == columns_)
+      {
+        return;
+      }
+
+      // Counts the rows first, to know how many must give way at the top.
+      const auto [used, at] {rewrap(columns, nullptr, 0, 0)};
+      const auto dropped {std::min(used - std::min(used, rows), at.row)};
+
+      if (history and dropped)
+      {
+        spare.assign(dropped * columns, cell {U' ', 0, 0});
+        rewrap(columns, spare.data(), 0, dropped);
+
+        for (std::size_t row {0}; row < dropped; ++row)
+        {
+          history->push(spare.data() + row * columns, columns, attributes);
+        }
+      }
+
+      spare.assign(rows * columns, cell {U' ', 0, 0});
+      rewrap(columns, spare.data(), dropped, rows);
+
+      cursor.row = std::min(at.row - dropped, rows - 1);
+      cursor.pending_wrap = autowrap and columns <= at.column;
+      cursor.column = std::min(at.column, columns - 1);
+
+      adopt(rows, columns);
+    }
+
+    void erase(const std::size_t row, const std::size_t first, const std::size_t last) noexcept
+    {
+      std::fill(line(row) + first, line(row) + std::min(last, columns_), blank());
+      damage(row, first, last);
+    }
+
+    // Moves lines of the scrolling region up; new lines at the bottom are blank.
+    // Lines scrolled off the top of the screen go to the history.
+    void scroll_up(std::size_t count = 1) noexcept
+    {
+      count = std::min(count, bottom - top);
+
+      for (std::size_t row {0}; history and top == 0 and row < count; ++row)
+      {
+        history->push(line(row), columns_, attributes);
+      }
+
+      if (top == 0 and bottom == rows_)
+      {
+        origin = (origin + count) % rows_;
+      }
+      else
+      {
+        rotate(top, bottom, count);
+      }
+
+      for (auto row {top}; row < bottom - count; ++row)
+      {
+        damage(row, 0, columns_);
+      }
+
+      for (auto row {bottom - count}; row < bottom; ++row)
+      {
+        erase(row, 0, columns_);
+      }
+    }
+
+    // Moves lines of the scrolling region down; new lines at the top are blank.
+    void scroll_down(std::size_t count = 1) noexcept
+    {
+      count = std::min(count, bottom - top);
+
+      if (top == 0 and bottom == rows_)
+      {
+        origin = (origin + rows_ - count) % rows_;
+      }
+      else
+      {
+        rotate(top, bottom, bottom - top - count);
+      }
+
+      for (auto row {top + count}; row < bottom; ++row)
+      {
+        damage(row, 0, columns_);
+      }
+
+      for (auto row {top}; row < top + count; ++row)
+      {
+        erase(row, 0, columns_);
+      }
+    }
+
+    // IL: moves the lines of the scrolling region from the cursor on down;
+    // new lines at the cursor are blank.
+    void insert_lines(std::size_t count) noexcept
+    {
+      count = std::min(count, bottom - cursor.row);
+
+      rotate(cursor.row, bottom, bottom - cursor.row - count);
+
+      for (auto row {cursor.row + count}; row < bottom; ++row)
+      {
+        damage(row, 0, columns_);
+      }
+
+      for (auto row {cursor.row}; row < cursor.row + count; ++row)
+      {
+        erase(row, 0, columns_);
+      }
+    }
+
+    // DL: moves the lines of the scrolling region below the deleted ones up,
+    // never into the history; new lines at the bottom are blank.
+    void delete_lines(std::size_t count) noexcept
+    {
+      count = std::min(count, bottom - cursor.row);
+
+      rotate(cursor.row, bottom, count);
+
+      for (auto row {cursor.row}; row < bottom - count; ++row)
+      {
+        damage(row, 0, columns_);
+      }
+
+      for (auto row {bottom - count}; row < bottom; ++row)
+      {
+        erase(row, 0, columns_);
+      }
+    }
+
+    // Writes one character of the given width at the cursor, honoring autowrap.
+    void put(const char32_t codepoint, const std::size_t width = 1) noexcept
+    {
+      // No row of a single column fits a double width character.
+      if (width == 2 and columns_ < 2)
+      {
+        return put(U'\uFFFD');
+      }
+
+      if (cursor.pending_wrap)
+      {
+        wrap();
+      }
+
+      if (width == 2 and cursor.column + 1 == columns_)
+      {
+        if (not autowrap)
+        {
+          return;
+        }
+
+        split(cursor.row, cursor.column, cursor.column + 1);
+        (*this)(cursor.row, cursor.column) = blank();
+        wrap();
+      }
+
+      split(cursor.row, cursor.column, cursor.column + width);
+
+      auto* const cells {line(cursor.row) + cursor.column};
+
+      if (width == 2)
+      {
+        cells[0] = cell {codepoint, cursor.attribute, cell::wide};
+        cells[1] = cell {U' ', cursor.attribute, cell::wide_spacer};
+      }
+      else
+      {
+        cells[0] = cell {codepoint, cursor.attribute, 0};
+      }
+
+      damage(cursor.row, cursor.column, cursor.column + width);
+      advance(width);
+    }
+
+    // Line feed: moves the cursor down, scrolling at the bottom margin.
+    void index() noexcept
+    {
+      if (cursor.row + 1 == bottom)
+      {
+        scroll_up();
+      }
+      else if (cursor.row + 1 < rows_)
+      {
+        ++cursor.row;
+      }
+      cursor.pending_wrap = false;
+    }
+
+    void reverse_index() noexcept
+    {
+      if (cursor.row == top)
+      {
+        scroll_down();
+      }
+      else if (0 < cursor.row)
+      {
+        --cursor.row;
+      }
+      cursor.pending_wrap = false;
+    }
+
+    void carriage_return() noexcept
+    {
+      cursor.column = 0;
+      cursor.pending_wrap = false;
+    }
+
+    void wrap() noexcept
+    {
+      (*this)(cursor.row, columns_ - 1).flags |= cell::wrapped;
+      damage(cursor.row, columns_ - 1, columns_);
+      carriage_return();
+      index();
+    }
+
+    // Blanks the other half of a double width character that writing over
+    // the columns from first to last of row would cut in two, so that it is
+    // not drawn across what replaces its half.
+    void split(const std::size_t row, const std::size_t first, const std::size_t last) noexcept
+    {
+      auto* const cells {line(row)};
+
+      const auto orphan {[&](const std::size_t column)
+      {
+        cells[column].codepoint = U' ';
+        cells[column].flags &= ~(cell::wide | cell::wide_spacer);
+        damage(row, column, column + 1);
+      }};
+
+      if (0 < first and cells[first].flags & cell::wide_spacer)
+      {
+        orphan(first - 1);
+      }
+
+      if (last < columns_ and cells[last - 1].flags & cell::wide)
+      {
+        orphan(last);
+      }
+    }
+
+    // Moves the cursor right after writing, deferring the wrap at the margin.
+    void advance(const std::size_t width) noexcept
+    {
+      if (cursor.column + width < columns_)
+      {
+        cursor.column += width;
+      }
+      else
+      {
+        cursor.column = columns_ - 1;
+        cursor.pending_wrap = autowrap;
+      }
+    }
+
+  private:
+    // Row and column in the rewrapped grid.
+    struct position
+    {
+      std::size_t row, column;
+    };
+
+    /**
+     * Lays the logical lines out again at the given width, writing the rows
+     * [first, first + count) of the result to target unless it is null.
+     * Returns the number of rows up to the last that is not blank or holds the
+     * cursor, and where the cursor lands; a column of columns means a wrap is
+     * pending there.
+     */
+    std::pair<std::size_t, position> rewrap(const std::size_t columns, cell* const target, const std::size_t first, const std::size_t count) const noexcept
+    {
+      const auto put = [&](const std::size_t row, const std::size_t column, const cell& value)
+      {
+        if (target and first <= row and row < first + count)
+        {
+          target[(row - first) * columns + column] = value;
+        }
+      };
+
+      position out {0, 0}, at {0, 0};
+
+      std::size_t used {0};
+
+      for (std::size_t row {0}; row < rows_; )
+      {
+        auto end {row};
+
+        while (end + 1 < rows_ and line(end)[columns_ - 1].flags & cell::wrapped)
+        {
+          ++end;
+        }
+
+        // The rows [row, end] are one line; its trailing blanks are not kept.
+        auto length {(end - row + 1) * columns_};
+
+        for (; length; --length)
+        {
+          const auto& last {line(row + (length - 1) / columns_)[(length - 1) % columns_]};
+
+          if (last.codepoint != U' ' or last.flags or last.attribute)
+          {
+            break;
+          }
+        }
+
+        const auto holds_cursor {row <= cursor.row and cursor.row <= end};
+        const auto cursor_offset {(cursor.row - row) * columns_ + cursor.column + cursor.pending_wrap};
+
+        out.column = 0;
+
+        for (std::size_t offset {0}; offset < length; ++offset)
+        {
+          auto value {line(row + offset / columns_)[offset % columns_]};
+
+          // No row of a single column fits a double width character.
+          const auto replaced {value.flags & cell::wide and columns < 2};
+
+          if (replaced)
+          {
+            value = cell {U'\uFFFD', value.attribute, 0};
+          }
+
+          const std::size_t width {value.flags & cell::wide ? 2u : 1u};
+
+          if (holds_cursor and offset == cursor_offset)
+          {
+            at = out;
+          }
+
+          if (columns < out.column + width)
+          {
+            if (out.column < columns)
+            {
+              put(out.row, out.column, cell {U' ', value.attribute, 0});
+            }
+
+            if (target and first <= out.row and out.row < first + count)
+            {
+              target[(out.row - first) * columns + columns - 1].flags |= cell::wrapped;
+            }
+
+            ++out.row;
+            out.column = 0;
+
+            if (holds_cursor and offset == cursor_offset)
+            {
+              at = out;
+            }
+          }
+
+          value.flags &= ~cell::wrapped;
+          put(out.row, out.column, value);
+
+          if (width == 2 and offset + 1 < length)
+          {
+            auto spacer {line(row + (offset + 1) / columns_)[(offset + 1) % columns_]};
+            spacer.flags &= ~cell::wrapped;
+            put(out.row, out.column + 1, spacer);
+            ++offset;
+          }
+          else if (replaced and offset + 1 < length)
+          {
+            ++offset; // its spacer
+          }
+
+          out.column += width;
+        }
+
+        // Past the end of what is kept of its line.
+        if (holds_cursor and length <= cursor_offset)
+        {
+          const auto column {out.column + cursor_offset - length};
+          at = column <= columns ? position {out.row, column} : position {out.row + column / columns, column % columns};
+        }
+
+        const auto last {holds_cursor ? std::max(out.row, at.row) : out.row};
+
+        if (holds_cursor or length)
+        {
+          used = last + 1;
+        }
+
+        out = position {last + 1, 0};
+        row = end + 1;
+      }
+
+      return {used, at};
+    }
+
+    // Replaces attributes by a table of the ones the cells and the cursor use,
+    // of the next generation, and has every cell redrawn.
+    void compact()
+    {
+      kept.clear(attributes.generation() + 1);
+      remapped.assign(attributes.size(), 0);
+
+      const auto remap {[&](const std::uint16_t index)
+      {
+        auto& mapped {remapped[index]};
+
+        if (not mapped)
+        {
+          mapped = kept.intern(attributes[index]) + 1u;
+        }
+
+        return static_cast<std::uint16_t>(mapped - 1);
+      }};
+
+      for (auto& each : cells)
+      {
+        each.attribute = remap(each.attribute);
+      }
+
+      cursor.attribute = remap(cursor.attribute);
+
+      std::swap(attributes, kept);
+      compact_at = std::min(std::max<std::size_t>(4096, 2 * attributes.size()), attribute_table::capacity);
+
+      damage_all();
+    }
+
+    // Takes spare, laid out as rows of columns, for the cells.
+    void adopt(const std::size_t rows, const std::size_t columns)
+    {
+      cells.swap(spare);
+      lines.resize(rows);
+
+      for (std::size_t row {0}; row < rows; ++row)
+      {
+        lines[row] = static_cast<std::uint32_t>(row * columns);
+      }
+
+      rows_ = rows;
+      columns_ = columns;
+      origin = 0;
+      top = 0;
+      bottom = rows;
+
+      damages.resize(rows);
+      damage_all();
+    }
+
+    // Rotates offsets of logical rows [first, last) left by count positions.
+    // Only offsets move; the ring is first unrolled so that logical rows are
+    // contiguous, which costs one pass over rows_ integers.
+    void rotate(const std::size_t first, const std::size_t last, const std::size_t count) noexcept
+    {
+      if (origin)
+      {
+        std::rotate(std::begin(lines), std::next(std::begin(lines), origin), std::end(lines));
+        origin = 0;
+      }
+
+      std::rotate(
+        std::next(std::begin(lines), first),
+        std::next(std::begin(lines), first + count),
+        std::next(std::begin(lines), last)
+      );
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SCREEN_HPP
@@ -0,0 +1,886 @@
+#ifndef INCLUDED_VT10X_SCROLLBACK_HPP
+#define INCLUDED_VT10X_SCROLLBACK_HPP
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(VT10X_LZ4)
+#include <lz4.h>
+#endif
+
+#include <vt10x/attribute.hpp>
+#include <vt10x/cell.hpp>
+#include <vt10x/slab_pool.hpp>
+#include <vt10x/utf8.hpp>
+
+namespace vt10x
+{
+  /**
+   * Lines scrolled off the top of the primary screen, oldest first, in three
+   * tiers. The most recent stay as cells, so scrolling back a little costs
+   * nothing. Older ones are packed into blocks as runs of equal attribute
+   * with their text in UTF-8, a few bytes per line of typical output, and
+   * compressed with LZ4 when built with VT10X_LZ4. Blocks past the memory
+   * cap move to an unlinked file that is read back through a mapping, so
+   * their pages belong to the page cache rather than to the process.
+   *
+   * Attributes are interned in tables of their own: lines outlive the table
+   * of the screen they came from. Once a table is full, the lines pushed from
+   * then on index a new one, and a table goes with the last line indexing it.
+   *
+   * Sealed blocks never change and carry a filter of the trigrams of their
+   * text, so that a search on another thread can take them, see sealed(),
+   * and skip most of those that cannot match. Everything else belongs to the
+   * thread that pushes.
+   *
+   * Blocks and their bytes come from pools, and hot lines keep the capacity
+   * of a whole row, so that once the history is full, a stream of output
+   * that drops a block for every block it seals allocates nothing.
+   *
+   * History is best effort: a line that cannot be stored for lack of memory
+   * or disk is dropped, never the session.
+   */
+  class scrollback
+  {
+  public:
+    struct limits
+    {
+      std::size_t lines {1000000}; // kept at most; the oldest are dropped
+
+      std::size_t memory {32 << 20}; // bytes of blocks kept in memory
+
+      std::string spill {}; // directory of the file blocks past memory go to, none if empty
+    };
+
+    // Bloom filter of the byte trigrams of a text: 16 Ki bits, one hash.
+    struct trigrams
+      : public std::array<std::uint64_t, 256>
+    {
+      // Of three bytes, the first in the lowest.
+      static constexpr std::uint32_t hash(const std::uint32_t trigram) noexcept
+      {
+        return trigram * 2654435761u >> 18;
+      }
+
+      static constexpr std::uint32_t hash(const unsigned char* const bytes) noexcept
+      {
+        return hash(bytes[0] | bytes[1] << 8 | bytes[2] << 16);
+      }
+
+      void add(const std::uint32_t trigram) noexcept
+      {
+        const auto bit {hash(trigram)};
+        (*this)[bit >> 6] |= std::uint64_t {1} << (bit & 63);
+      }
+
+      // False if text cannot occur in what was added.
+      bool may_contain(const std::string_view text) const noexcept
+      {
+        for (std::size_t index {0}; index + 3 <= text.size(); ++index)
+        {
+          const auto bit {hash(reinterpret_cast<const unsigned char*>(text.data() + index))};
+
+          if (not ((*this)[bit >> 6] & std::uint64_t {1} << (bit & 63)))
+          {
+            return false;
+          }
+        }
+
+        return true;
+      }
+    };
+
+    // Bytes of blocks, from the pool of scrollbacks.
+    using storage = std::basic_string<char, std::char_traits<char>, slab_pool::allocator<char>>;
+
+    struct block
+    {
+      std::size_t first, lines; // line numbers [first, first + lines)
+
+      std::size_t size; // packed, before compression
+
+      std::size_t stored; // bytes in memory or in the file
+
+      storage bytes; // empty once spilled
+
+      off_t offset; // in the file once spilled, -1 before
+
+      bool compressed;
+
+      trigrams index;
+    };
+
+  private:
+    static constexpr std::size_t hot_lines {1024}, block_size {64 << 10}, block_capacity {block_size + block_size / 8};
+
+    // Of the blocks themselves, and of their bytes, also once compressed.
+    std::shared_ptr<slab_pool> nodes {std::make_shared<slab_pool>(256, 4 << 10)}, slabs {std::make_shared<slab_pool>(8 << 10, 80 << 10)};
+
+    limits limit {};
+
+    struct generation
+    {
+      std::size_t first; // number of the first line indexing attributes
+
+      attribute_table attributes;
+    };
+
+    std::vector<generation> generations {generation {0, attribute_table {}}}; // the oldest first
+
+    attribute_table retired {}; // the last table let go, for the next generation
+
+    // The last attribute push() interned, as a cache for runs of cells.
+    const attribute_table* source {nullptr};
+
+    std::uint32_t source_generation {0};
+
+    std::uint16_t from {0}, to {0};
+
+    std::vector<std::vector<cell>> hot {}; // ring, each line keeps its capacity
+
+    std::size_t hot_first {0}, hot_count {0};
+
+    storage open {storage::allocator_type {slabs}}; // the block being packed
+
+    std::string scratch {}; // its next line
+
+    std::size_t open_lines {0};
+
+    trigrams open_index {};
+
+    std::vector<std::shared_ptr<const block>> blocks {}; // spilled ones first
+
+    mutable std::mutex guard {}; // of blocks, against sealed()
+
+    std::size_t spilled {0}, resident {0}; // blocks spilled, bytes of the others
+
+    std::size_t first_ {0}, count {0}; // number of the oldest line, and lines kept
+
+    int file {-1};
+
+    off_t end {0};
+
+    mutable const char* map {nullptr};
+
+    mutable std::size_t mapped {0};
+
+    // The last block read, decompressed.
+    mutable std::string cache {};
+
+    mutable std::size_t cached {SIZE_MAX};
+
+  public:
+    explicit scrollback()
+    {
+      open.reserve(block_capacity);
+    }
+
+    scrollback(const scrollback&) = delete;
+    scrollback& operator=(const scrollback&) = delete;
+
+    ~scrollback()
+    {
+      unmap();
+
+      if (0 <= file)
+      {
+        close(file);
+      }
+    }
+
+    void configure(const limits& value)
+    {
+      limit = value;
+      trim();
+    }
+
+    auto size() const noexcept
+    {
+      return count;
+    }
+
+    // Number of the oldest line kept; lines are numbered from the first ever
+    // pushed, so a number stays valid while the line is kept.
+    auto first() const noexcept
+    {
+      return first_;
+    }
+
+    // What the attributes of cells read back from line index index.
+    const attribute_table& attributes(const std::size_t index) const noexcept
+    {
+      return std::prev(std::upper_bound(generations.begin(), generations.end(), first_ + index, [](const auto number, const auto& each)
+      {
+        return number < each.first;
+      }))->attributes;
+    }
+
+    // Bytes of packed blocks in memory and in the file.
+    auto footprint() const noexcept
+    {
+      return std::pair {resident + open.size(), static_cast<std::size_t>(end)};
+    }
+
+    void clear() noexcept
+    {
+      hot_first = hot_count = open_lines = spilled = resident = count = 0;
+      open.clear();
+      cached = SIZE_MAX;
+
+      generations.erase(generations.begin(), std::prev(generations.end()));
+      generations.back().first = first_;
+
+      {
+        const std::lock_guard<std::mutex> lock {guard};
+        blocks.clear();
+      }
+
+      unmap();
+
+      if (0 <= file and ftruncate(file, 0) == 0)
+      {
+        end = 0;
+      }
+    }
+
+    // Stores a row of columns cells whose attributes index table; trailing
+    // blanks are not kept.
+    void push(const cell* const line, std::size_t columns, const attribute_table& table) noexcept
+    {
+      const auto width {columns};
+
+      while (columns and line[columns - 1].codepoint == U' ' and not line[columns - 1].flags and not line[columns - 1].attribute)
+      {
+        --columns;
+      }
+
+      try
+      {
+        if (hot.size() < std::min(hot_lines, limit.lines))
+        {
+          hot.emplace_back();
+        }
+
+        if (hot.empty())
+        {
+          return;
+        }
+
+        if (hot_count == hot.size())
+        {
+          evict();
+        }
+
+        auto& slot {hot[(hot_first + hot_count) % hot.size()]};
+
+        if (slot.capacity() < width)
+        {
+          slot.reserve(width);
+        }
+
+        // Every attribute of the line must fit in the table it will index.
+        if (attribute_table::capacity < generations.back().attributes.size() + columns)
+        {
+          retired.clear(generations.back().attributes.generation() + 1);
+          generations.push_back(generation {first_ + count, std::move(retired)});
+          source = nullptr;
+        }
+
+        auto& attributes {generations.back().attributes};
+
+        slot.assign(line, line + columns);
+
+        for (auto& each : slot)
+        {
+          if (source != &table or source_generation != table.generation() or from != each.attribute)
+          {
+            source = &table;
+            source_generation = table.generation();
+            from = each.attribute;
+            to = attributes.intern(table[each.attribute]);
+          }
+
+          each.attribute = to;
+        }
+
+        ++hot_count;
+        ++count;
+
+        trim();
+      }
+      catch (...)
+      {
+        // the line is lost
+      }
+    }
+
+    // Line index of size(), 0 the oldest, as cells that index attributes(index).
+    void read(const std::size_t index, std::vector<cell>& out) const
+    {
+      out.clear();
+
+      const auto number {first_ + index};
+      const auto hot_begin {first_ + count - hot_count}, open_begin {hot_begin - open_lines};
+
+      if (hot_begin <= number)
+      {
+        const auto& line {hot[(hot_first + number - hot_begin) % hot.size()]};
+        out.assign(line.begin(), line.end());
+      }
+      else if (open_begin <= number)
+      {
+        unpack(open, number - open_begin, out);
+      }
+      else
+      {
+        const auto& found {**std::prev(std::upper_bound(blocks.begin(), blocks.end(), number, [](const auto number, const auto& each)
+        {
+          return number < each->first;
+        }))};
+
+        unpack(load(found), number - found.first, out);
+      }
+    }
+
+    // The sealed blocks, oldest first, for any thread.
+    std::vector<std::shared_ptr<const block>> sealed() const
+    {
+      const std::lock_guard<std::mutex> lock {guard};
+      return {blocks.begin(), blocks.end()};
+    }
+
+    /**
+     * Appends the text of the lines of a sealed block to text, each followed
+     * by a newline, and where each starts to starts. Any thread may call it:
+     * it reads only the block and the file, with buffer as scratch. False if
+     * the block could not be read, e.g. it was dropped from the file since.
+     */
+    bool text(const block& each, std::string& buffer, std::string& text, std::vector<std::uint32_t>& starts) const
+    {
+      std::string_view stored {each.bytes};
+
+      if (0 <= each.offset)
+      {
+        buffer.resize(each.stored);
+
+        if (pread(file, buffer.data(), each.stored, each.offset) != static_cast<ssize_t>(each.stored))
+        {
+          return false;
+        }
+
+        stored = buffer;
+      }
+
+      if (each.compressed)
+      {
+        #if defined(VT10X_LZ4)
+        std::string packed (each.size, '\0');
+
+        if (LZ4_decompress_safe(stored.data(), packed.data(), static_cast<int>(stored.size()), static_cast<int>(packed.size())) != static_cast<int>(each.size))
+        {
+          return false;
+        }
+
+        buffer = std::move(packed);
+        stored = buffer;
+        #else
+        return false;
+        #endif
+      }
+
+      return lines(stored, text, starts);
+    }
+
+    // Like text(), for the lines that are not sealed yet, on the thread that
+    // pushes; returns the number of the first of them.
+    std::size_t recent(std::string& text, std::vector<std::uint32_t>& starts) const
+    {
+      lines(open, text, starts);
+
+      for (std::size_t index {0}; index < hot_count; ++index)
+      {
+        starts.push_back(static_cast<std::uint32_t>(text.size()));
+
+        for (const auto& each : hot[(hot_first + index) % hot.size()])
+        {
+          if (not (each.flags & cell::wide_spacer))
+          {
+            char bytes[4];
+            auto* last {bytes};
+            encode_utf8(each.codepoint, last);
+            text.append(bytes, last);
+          }
+        }
+
+        text += '\n';
+      }
+
+      return first_ + count - hot_count - open_lines;
+    }
+
+  private:
+    static void put(char*& out, std::uint32_t value) noexcept
+    {
+      for (; 0x80 <= value; value >>= 7)
+      {
+        *out++ = static_cast<char>(value | 0x80);
+      }
+      *out++ = static_cast<char>(value);
+    }
+
+    static std::uint32_t get(const char*& in) noexcept
+    {
+      std::uint32_t value {0};
+
+      for (unsigned shift {0}; ; shift += 7)
+      {
+        const auto byte {static_cast<unsigned char>(*in++)};
+        value |= std::uint32_t {byte & 0x7Fu} << shift;
+
+        if (byte < 0x80)
+        {
+          return value;
+        }
+      }
+    }
+
+    /**
+     * A line is its length in bytes, then runs of cells of equal attribute
+     * and flags: attribute, flags, number of characters and their UTF-8.
+     * Spacers of wide characters are not stored but implied by the flag.
+     */
+    void pack(const std::vector<cell>& line, storage& out)
+    {
+      // At most 4 bytes per cell and 9 bytes of header per run.
+      if (scratch.size() < line.size() * 13)
+      {
+        scratch.resize(line.size() * 13);
+      }
+
+      auto* const body {scratch.data()};
+      auto* position {body};
+
+      // The last three bytes of text, across runs.
+      std::uint32_t trigram {0}, bytes {0};
+
+      for (std::size_t index {0}; index < line.size(); )
+      {
+        const auto attribute {line[index].attribute}, flags {line[index].flags};
+        const auto step = [&](const std::size_t at) -> std::size_t
+        {
+          return flags & cell::wide and at + 1 < line.size() and line[at + 1].flags & cell::wide_spacer ? 2 : 1;
+        };
+
+        auto last {index};
+        std::uint32_t characters {0};
+
+        for (; last < line.size() and line[last].attribute == attribute and line[last].flags == flags; last += step(last))
+        {
+          ++characters;
+        }
+
+        put(position, attribute);
+        put(position, flags);
+        put(position, characters);
+
+        for (; index < last; index += step(index))
+        {
+          const auto* const text {position};
+
+          encode_utf8(line[index].codepoint, position);
+
+          for (const auto* each {text}; each != position; ++each)
+          {
+            trigram = trigram >> 8 | std::uint32_t {static_cast<unsigned char>(*each)} << 16;
+
+            if (3 <= ++bytes)
+            {
+              open_index.add(trigram);
+            }
+          }
+        }
+      }
+
+      const auto size {static_cast<std::uint32_t>(position - body)};
+
+      char header[5];
+      auto* length {header};
+      put(length, size);
+
+      out.append(header, length);
+      out.append(body, size);
+    }
+
+    // Decodes the line index of the packed lines in.
+    static void unpack(const std::string_view in, std::size_t index, std::vector<cell>& out)
+    {
+      if (in.empty())
+      {
+        return;
+      }
+
+      const auto* position {in.data()};
+
+      for (; index; --index)
+      {
+        position += get(position);
+      }
+
+      const auto length {get(position)};
+
+      for (const auto* const last {position + length}; position < last; )
+      {
+        const auto attribute {static_cast<std::uint16_t>(get(position))}, flags {static_cast<std::uint16_t>(get(position))};
+
+        for (auto characters {get(position)}; characters; --characters)
+        {
+          const auto byte {static_cast<unsigned char>(*position++)};
+          const auto& lead {utf8_leads[byte]};
+
+          char32_t codepoint {static_cast<char32_t>(lead.size ? byte & lead.mask : byte)};
+
+          for (auto remaining {lead.size}; remaining; --remaining)
+          {
+            codepoint = codepoint << 6 | (static_cast<unsigned char>(*position++) & 0x3F);
+          }
+
+          out.push_back(cell {codepoint, attribute, flags});
+
+          if (flags & cell::wide)
+          {
+            out.push_back(cell {U' ', attribute, cell::wide_spacer});
+          }
+        }
+      }
+    }
+
+    // Checked decoding of the text of packed lines, see text().
+    static bool lines(const std::string_view in, std::string& text, std::vector<std::uint32_t>& starts)
+    {
+      const auto* position {in.data()};
+      const auto* const end {in.data() + in.size()};
+
+      const auto number = [&](std::uint32_t& value)
+      {
+        value = 0;
+
+        for (unsigned shift {0}; position < end and shift < 32; shift += 7)
+        {
+          const auto byte {static_cast<unsigned char>(*position++)};
+          value |= std::uint32_t {byte & 0x7Fu} << shift;
+
+          if (byte < 0x80)
+          {
+            return true;
+          }
+        }
+
+        return false;
+      };
+
+      for (std::uint32_t length {0}; position < end; )
+      {
+        if (not number(length) or static_cast<std::size_t>(end - position) < length)
+        {
+          return false;
+        }
+
+        starts.push_back(static_cast<std::uint32_t>(text.size()));
+
+        for (const auto* const last {position + length}; position < last; )
+        {
+          std::uint32_t attribute, flags, characters;
+
+          if (not number(attribute) or not number(flags) or not number(characters))
+          {
+            return false;
+          }
+
+          const auto* const run {position};
+
+          for (; characters and position < last; --characters)
+          {
+            position += 1 + utf8_leads[static_cast<unsigned char>(*position)].size;
+          }
+
+          if (last < position)
+          {
+            return false;
+          }
+
+          text.append(run, position);
+        }
+
+        text += '\n';
+      }
+
+      return true;
+    }
+
+    // Moves the oldest hot line into the open block, sealed once it is full.
+    void evict()
+    {
+      // Sealed early rather than outgrow its storage, see pack().
+      if (open_lines and open.capacity() < open.size() + hot[hot_first].size() * 13 + 5)
+      {
+        seal();
+      }
+
+      pack(hot[hot_first], open);
+      hot_first = (hot_first + 1) % hot.size();
+      --hot_count;
+      ++open_lines;
+
+      if (block_size <= open.size())
+      {
+        seal();
+      }
+    }
+
+    void seal()
+    {
+      auto sealed {std::allocate_shared<block>(
+        slab_pool::allocator<block> {nodes},
+        block {first_ + count - hot_count - open_lines, open_lines, open.size(), open.size(), storage {open.get_allocator()}, -1, false, open_index}
+      )};
+
+      open_index = trigrams {};
+
+      #if defined(VT10X_LZ4)
+      storage packed (static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(open.size()))), '\0', open.get_allocator());
+
+      if (const auto size {LZ4_compress_default(open.data(), packed.data(), static_cast<int>(open.size()), static_cast<int>(packed.size()))}; 0 < size and static_cast<std::size_t>(size) < open.size())
+      {
+        // Copied out to the size it has, or it would keep a slab of the bound.
+        sealed->bytes.assign(packed.data(), static_cast<std::size_t>(size));
+        sealed->stored = sealed->bytes.size();
+        sealed->compressed = true;
+      }
+      #endif
+
+      if (sealed->compressed)
+      {
+        open.clear();
+      }
+      else
+      {
+        sealed->bytes = std::move(open);
+
+        open = storage {sealed->bytes.get_allocator()};
+        open.reserve(block_capacity);
+      }
+
+      open_lines = 0;
+
+      resident += sealed->stored;
+
+      {
+        const std::lock_guard<std::mutex> lock {guard};
+        blocks.push_back(std::move(sealed));
+      }
+
+      while (limit.memory < resident and spilled < blocks.size())
+      {
+        if (not spill(blocks[spilled]))
+        {
+          drop();
+        }
+      }
+    }
+
+    // Writes a block to the end of the file, which is opened on first use,
+    // and replaces it by one without the bytes: a search may still hold it.
+    bool spill(std::shared_ptr<const block>& each) noexcept
+    {
+      if (limit.spill.empty())
+      {
+        return false;
+      }
+
+      if (file < 0 and (file = ::open(limit.spill.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)) < 0)
+      {
+        return false;
+      }
+
+      for (std::size_t written {0}; written < each->stored; )
+      {
+        if (const auto size {pwrite(file, each->bytes.data() + written, each->stored - written, end + static_cast<off_t>(written))}; 0 < size)
+        {
+          written += static_cast<std::size_t>(size);
+        }
+        else if (size < 0 and errno == EINTR)
+        {
+          continue;
+        }
+        else
+        {
+          return false;
+        }
+      }
+
+      try
+      {
+        auto moved {std::allocate_shared<block>(
+          slab_pool::allocator<block> {nodes},
+          block {each->first, each->lines, each->size, each->stored, {}, end, each->compressed, each->index}
+        )};
+
+        const std::lock_guard<std::mutex> lock {guard};
+        each = std::move(moved);
+      }
+      catch (...)
+      {
+        return false;
+      }
+
+      end += static_cast<off_t>(each->stored);
+
+      resident -= each->stored;
+      ++spilled;
+
+      return true;
+    }
+
+    // Forgets the oldest block, giving its space in the file back.
+    void drop() noexcept
+    {
+      const auto& oldest {*blocks.front()};
+
+      if (oldest.offset < 0)
+      {
+        resident -= oldest.stored;
+      }
+      else
+      {
+        fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, oldest.offset, static_cast<off_t>(oldest.stored));
+        --spilled;
+      }
+
+      if (cached == oldest.first)
+      {
+        cached = SIZE_MAX;
+      }
+
+      first_ += oldest.lines;
+      count -= oldest.lines;
+
+      const std::lock_guard<std::mutex> lock {guard};
+      blocks.erase(blocks.begin());
+    }
+
+    // Keeps the line limit, dropping whole blocks while there are any.
+    void trim() noexcept
+    {
+      while (limit.lines < count and not blocks.empty())
+      {
+        drop();
+      }
+
+      if (limit.lines < count and open_lines)
+      {
+        open.clear();
+        first_ += open_lines;
+        count -= open_lines;
+        open_lines = 0;
+      }
+
+      while (limit.lines < count and hot_count)
+      {
+        hot_first = (hot_first + 1) % hot.size();
+        --hot_count;
+        ++first_;
+        --count;
+      }
+
+      // The tables only lines no longer kept indexed.
+      while (1 < generations.size() and generations[1].first <= first_)
+      {
+        std::swap(retired, generations.front().attributes);
+        generations.erase(generations.begin());
+      }
+    }
+
+    // The packed lines of a block, decompressed or read back as needed.
+    std::string_view load(const block& each) const
+    {
+      if (not each.compressed and each.offset < 0)
+      {
+        return each.bytes;
+      }
+
+      if (cached == each.first)
+      {
+        return cache;
+      }
+
+      std::string_view stored {each.bytes};
+
+      if (0 <= each.offset)
+      {
+        if (mapped < static_cast<std::size_t>(end))
+        {
+          unmap();
+
+          if (auto* const pointer {mmap(nullptr, static_cast<std::size_t>(end), PROT_READ, MAP_SHARED, file, 0)}; pointer != MAP_FAILED)
+          {
+            map = static_cast<const char*>(pointer);
+            mapped = static_cast<std::size_t>(end);
+          }
+          else
+          {
+            return {};
+          }
+        }
+
+        stored = std::string_view {map + each.offset, each.stored};
+
+        if (not each.compressed)
+        {
+          return stored;
+        }
+      }
+
+      #if defined(VT10X_LZ4)
+      cache.resize(each.size);
+
+      if (LZ4_decompress_safe(stored.data(), cache.data(), static_cast<int>(stored.size()), static_cast<int>(cache.size())) != static_cast<int>(each.size))
+      {
+        cached = SIZE_MAX;
+        return {};
+      }
+
+      cached = each.first;
+      return cache;
+      #else
+      return {};
+      #endif
+    }
+
+    void unmap() const noexcept
+    {
+      if (map)
+      {
+        munmap(const_cast<char*>(map), mapped);
+        map = nullptr;
+        mapped = 0;
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SCROLLBACK_HPP
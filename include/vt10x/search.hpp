@@ -0,0 +1,310 @@
+#ifndef INCLUDED_VT10X_SEARCH_HPP
+#define INCLUDED_VT10X_SEARCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <vt10x/notifier.hpp>
+#include <vt10x/scrollback.hpp>
+#include <vt10x/simd.hpp>
+
+namespace vt10x
+{
+  /**
+   * Searches a scrollback on a thread of its own, newest lines first, and
+   * hands matches over in batches as they are found, so that typing the
+   * pattern never waits for a scan. A new find() abandons the one running.
+   *
+   * Plain patterns skip the sealed blocks whose trigram filter rules them
+   * out, and the rest are scanned with simd::find() over the text of the
+   * whole block. While a pattern is typed, each one contains the one before,
+   * so blocks in which the previous pattern was not found are skipped too.
+   * Regular expressions (ECMAScript) are matched line by line, once per line.
+   */
+  class search
+  {
+  public:
+    struct match
+    {
+      std::size_t line; // as numbered by scrollback::first()
+
+      std::uint32_t offset, length; // bytes of the text of the line
+    };
+
+    static constexpr std::size_t match_limit {100000};
+
+  private:
+    struct query
+    {
+      std::string pattern;
+
+      std::optional<std::regex> expression;
+
+      std::uint64_t generation;
+
+      std::vector<std::shared_ptr<const scrollback::block>> blocks; // oldest first
+
+      std::string recent; // text of the lines not sealed yet
+
+      std::vector<std::uint32_t> starts;
+
+      std::size_t first; // number of the first line of recent
+    };
+
+    const scrollback& history;
+
+    std::mutex guard {};
+
+    std::condition_variable wakeup {};
+
+    std::optional<query> next {};
+
+    std::vector<match> found {};
+
+    bool finished {true}, stopping {false};
+
+    std::atomic<std::uint64_t> generation {0};
+
+    notifier ready {};
+
+    // Of the last plain pattern scanned to the end, for the next one: the
+    // first line of each block scanned, and of those that matched.
+    std::string previous {};
+
+    std::unordered_set<std::size_t> scanned {}, matched {};
+
+    std::thread thread;
+
+  public:
+    explicit search(const scrollback& history)
+      : history {history}
+      , thread {[this]() { run(); }}
+    {}
+
+    search(const search&) = delete;
+    search& operator=(const search&) = delete;
+
+    ~search()
+    {
+      {
+        const std::lock_guard<std::mutex> lock {guard};
+        stopping = true;
+      }
+
+      generation.fetch_add(1, std::memory_order_relaxed);
+      wakeup.notify_one();
+      thread.join();
+    }
+
+    // Readable when matches are waiting or the search finished.
+    auto descriptor() const noexcept
+    {
+      return ready.descriptor();
+    }
+
+    /**
+     * Starts searching for pattern, a regular expression if regex, of which
+     * std::regex_error is thrown here if it is malformed. Call it from the
+     * thread that pushes to the scrollback: the lines that are not sealed
+     * are copied first.
+     */
+    void find(const std::string& pattern, const bool regex = false)
+    {
+      query value {pattern, {}, generation.fetch_add(1, std::memory_order_relaxed) + 1, history.sealed(), {}, {}, 0};
+
+      if (regex)
+      {
+        value.expression.emplace(pattern, std::regex::ECMAScript | std::regex::optimize);
+      }
+
+      value.first = history.recent(value.recent, value.starts);
+
+      {
+        const std::lock_guard<std::mutex> lock {guard};
+        next = std::move(value);
+        found.clear();
+        finished = false;
+      }
+
+      wakeup.notify_one();
+    }
+
+    // Calls f(const std::vector<match>&) with the matches found since the
+    // last call; returns true once the search is finished.
+    template <typename F>
+    bool consume(F&& f)
+    {
+      ready.clear();
+
+      std::vector<match> batch {};
+      bool done {false};
+
+      {
+        const std::lock_guard<std::mutex> lock {guard};
+        batch.swap(found);
+        done = finished and not next;
+      }
+
+      // Nothing signals again until the next find(), so a loop waiting on
+      // the descriptor does not wake up for a search that is over.
+      if (done)
+      {
+        ready.clear();
+      }
+
+      if (not batch.empty())
+      {
+        f(static_cast<const std::vector<match>&>(batch));
+      }
+
+      return done;
+    }
+
+  private:
+    void run()
+    {
+      std::string buffer {}, text {};
+      std::vector<std::uint32_t> starts {};
+
+      for (;;)
+      {
+        query current {};
+
+        {
+          std::unique_lock<std::mutex> lock {guard};
+          wakeup.wait(lock, [this]() { return stopping or next; });
+
+          if (stopping)
+          {
+            return;
+          }
+
+          current = std::move(*next);
+          next.reset();
+        }
+
+        const auto narrowing {not current.expression and not previous.empty() and current.pattern.find(previous) != std::string::npos};
+
+        std::unordered_set<std::size_t> now_scanned {}, now_matched {};
+        std::size_t total {0};
+
+        const auto abandoned = [&]()
+        {
+          return generation.load(std::memory_order_relaxed) != current.generation or match_limit <= total;
+        };
+
+        total += scan(current, current.recent, current.starts, current.first);
+
+        for (auto each {current.blocks.rbegin()}; each != current.blocks.rend() and not abandoned(); ++each)
+        {
+          const auto& block {**each};
+
+          if (not current.expression)
+          {
+            if (not block.index.may_contain(current.pattern) or (narrowing and scanned.count(block.first) and not matched.count(block.first)))
+            {
+              now_scanned.insert(block.first);
+              continue;
+            }
+          }
+
+          text.clear();
+          starts.clear();
+
+          if (history.text(block, buffer, text, starts))
+          {
+            const auto count {scan(current, text, starts, block.first)};
+
+            total += count;
+            now_scanned.insert(block.first);
+
+            if (count)
+            {
+              now_matched.insert(block.first);
+            }
+          }
+        }
+
+        const std::lock_guard<std::mutex> lock {guard};
+
+        if (generation.load(std::memory_order_relaxed) == current.generation)
+        {
+          finished = true;
+          ready.signal();
+
+          if (not current.expression and total < match_limit)
+          {
+            previous = current.pattern;
+            scanned.swap(now_scanned);
+            matched.swap(now_matched);
+          }
+        }
+      }
+    }
+
+    /**
+     * Finds the pattern in text, whose lines begin at starts and are numbered
+     * from first, and publishes what it found, the newest lines first, unless
+     * a newer find() came meanwhile. Returns the number of matches.
+     */
+    std::size_t scan(const query& current, const std::string& text, const std::vector<std::uint32_t>& starts, const std::size_t first)
+    {
+      std::vector<match> results {};
+
+      if (current.expression)
+      {
+        for (std::size_t line {0}; line < starts.size(); ++line)
+        {
+          const auto* const begin {text.data() + starts[line]};
+          const auto* const end {line + 1 < starts.size() ? text.data() + starts[line + 1] - 1 : text.data() + text.size() - 1};
+
+          if (std::cmatch found {}; std::regex_search(begin, end, found, *current.expression))
+          {
+            results.push_back(match {first + line, static_cast<std::uint32_t>(found.position(0)), static_cast<std::uint32_t>(found.length(0))});
+          }
+        }
+      }
+      else if (not current.pattern.empty())
+      {
+        const auto* const end {text.data() + text.size()};
+
+        for (const auto* at {simd::find(text.data(), end, current.pattern)}; at != end; at = simd::find(at + current.pattern.size(), end, current.pattern))
+        {
+          const auto offset {static_cast<std::uint32_t>(at - text.data())};
+          const auto line {static_cast<std::size_t>(std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1)};
+
+          results.push_back(match {first + line, offset - starts[line], static_cast<std::uint32_t>(current.pattern.size())});
+        }
+      }
+
+      std::reverse(results.begin(), results.end());
+
+      const std::lock_guard<std::mutex> lock {guard};
+
+      if (generation.load(std::memory_order_relaxed) != current.generation or results.empty())
+      {
+        return results.size();
+      }
+
+      found.insert(found.end(), results.begin(), results.end());
+      ready.signal();
+
+      return results.size();
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SEARCH_HPP
@@ -0,0 +1,174 @@
+#ifndef INCLUDED_VT10X_SELECTION_HPP
+#define INCLUDED_VT10X_SELECTION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vt10x/cell.hpp>
+#include <vt10x/screen.hpp>
+#include <vt10x/utf8.hpp>
+
+namespace vt10x
+{
+  /**
+   * The cells between two points of a screen in reading order, as a drag of
+   * the pointer selects them. They are copied when the selection is made, as
+   * the screen goes on changing, but become text only when a reader reads
+   * them, a piece at a time, so that a paste never needs the whole text at
+   * once and a selection nobody pastes is never serialized.
+   */
+  class selection
+  {
+  public:
+    struct point
+    {
+      std::size_t row, column;
+
+      friend constexpr bool operator<(const point& lhs, const point& rhs) noexcept
+      {
+        return lhs.row < rhs.row or (lhs.row == rhs.row and lhs.column < rhs.column);
+      }
+
+      friend constexpr bool operator==(const point& lhs, const point& rhs) noexcept
+      {
+        return lhs.row == rhs.row and lhs.column == rhs.column;
+      }
+    };
+
+    // Both ends included, first not after last.
+    struct region
+    {
+      point first, last;
+
+      static constexpr region between(const point& anchor, const point& extent) noexcept
+      {
+        return extent < anchor ? region {extent, anchor} : region {anchor, extent};
+      }
+
+      // What a drag from anchor selects once released at extent, which no
+      // motion may have reported; a click, released where it was pressed
+      // with nothing dragged over, selects nothing.
+      static constexpr std::optional<region> released(const point& anchor, const point& extent, const bool dragged) noexcept
+      {
+        if (dragged or not (extent == anchor))
+        {
+          return between(anchor, extent);
+        }
+
+        return std::nullopt;
+      }
+
+      // The columns of row within the region, of a screen of that many; row
+      // is one of [first.row, last.row].
+      constexpr span columns(const std::size_t row, const std::size_t count) const noexcept
+      {
+        const auto begin {row == first.row ? first.column : 0};
+        const auto end {row == last.row ? last.column + 1 : count};
+
+        return span {static_cast<std::uint32_t>(std::min(begin, count)), static_cast<std::uint32_t>(std::min(end, count))};
+      }
+    };
+
+  private:
+    std::vector<cell> cells {};
+
+    // End of each row in cells, and whether autowrap continues it, in which
+    // case no newline follows.
+    std::vector<std::pair<std::size_t, bool>> rows {};
+
+  public:
+    explicit selection(const screen& screen, const region& region)
+    {
+      for (auto row {region.first.row}; row <= region.last.row and row < screen.rows(); ++row)
+      {
+        const auto* const line {screen.line(row)};
+
+        auto [first, last] {region.columns(row, screen.columns())};
+
+        // Neither half of a double width character goes without the other.
+        if (first < last and line[first].flags & cell::wide_spacer)
+        {
+          --first;
+        }
+
+        const auto continued {last == screen.columns() and line[last - 1].flags & cell::wrapped};
+
+        for (; not continued and first < last and line[last - 1].codepoint == U' ' and not (line[last - 1].flags & (cell::wide | cell::wide_spacer)); --last);
+
+        cells.insert(cells.end(), line + first, line + last);
+        rows.emplace_back(cells.size(), continued);
+      }
+    }
+
+    auto empty() const noexcept
+    {
+      return cells.empty();
+    }
+
+    // Serializes a selection as UTF-8, lines joined by newlines.
+    class reader
+    {
+      const selection* source;
+
+      std::size_t row {0}, index {0};
+
+    public:
+      explicit reader(const selection& source) noexcept
+        : source {&source}
+      {}
+
+      auto done() const noexcept
+      {
+        return row == source->rows.size();
+      }
+
+      // Writes out the next at most capacity bytes of the text, never a part
+      // of a character; returns how many.
+      std::size_t read(char* const out, const std::size_t capacity) noexcept
+      {
+        auto* position {out};
+        const auto* const end {out + capacity};
+
+        for (; row < source->rows.size(); ++row)
+        {
+          const auto [last, continued] {source->rows[row]};
+
+          for (; index < last; ++index)
+          {
+            const auto& each {source->cells[index]};
+
+            if (each.flags & cell::wide_spacer)
+            {
+              continue;
+            }
+
+            if (end - position < 4)
+            {
+              return position - out;
+            }
+
+            encode_utf8(each.codepoint, position);
+          }
+
+          if (not continued and row + 1 < source->rows.size())
+          {
+            if (position == end)
+            {
+              return position - out;
+            }
+
+            *position++ = '\n';
+          }
+        }
+
+        return position - out;
+      }
+    };
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SELECTION_HPP
@@ -0,0 +1,216 @@
+#ifndef INCLUDED_VT10X_SIMD_HPP
+#define INCLUDED_VT10X_SIMD_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace vt10x::simd
+{
+  constexpr bool is_control(const unsigned char byte) noexcept
+  {
+    return byte < 0x20 or byte == 0x7F;
+  }
+
+  /**
+   * Returns the first C0 control (which includes ESC) or DEL in [first, last),
+   * or last if there is none. Everything before it is printable in the ground
+   * state, so the parser can hand the whole run to the grid at once.
+   */
+  inline const char* find_control(const char* first, const char* const last) noexcept
+  {
+    #if defined(__AVX2__)
+    for (const auto c0 {_mm256_set1_epi8(0x1F)}, del {_mm256_set1_epi8(0x7F)}; 32 <= last - first; first += 32)
+    {
+      const auto bytes {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first))};
+
+      const auto found {_mm256_or_si256(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, c0), bytes), // unsigned bytes <= 0x1F
+        _mm256_cmpeq_epi8(bytes, del)
+      )};
+
+      if (const auto mask {static_cast<std::uint32_t>(_mm256_movemask_epi8(found))}; mask)
+      {
+        return first + __builtin_ctz(mask);
+      }
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    for (const auto c0 {_mm_set1_epi8(0x1F)}, del {_mm_set1_epi8(0x7F)}; 16 <= last - first; first += 16)
+    {
+      const auto bytes {_mm_loadu_si128(reinterpret_cast<const __m128i*>(first))};
+
+      const auto found {_mm_or_si128(
+        _mm_cmpeq_epi8(_mm_min_epu8(bytes, c0), bytes),
+        _mm_cmpeq_epi8(bytes, del)
+      )};
+
+      if (const auto mask {static_cast<std::uint32_t>(_mm_movemask_epi8(found))}; mask)
+      {
+        return first + __builtin_ctz(mask);
+      }
+    }
+    #elif defined(__ARM_NEON)
+    for (const auto c0 {vdupq_n_u8(0x1F)}, del {vdupq_n_u8(0x7F)}; 16 <= last - first; first += 16)
+    {
+      const auto bytes {vld1q_u8(reinterpret_cast<const std::uint8_t*>(first))};
+
+      const auto found {vorrq_u8(vcleq_u8(bytes, c0), vceqq_u8(bytes, del))};
+
+      // Narrow each byte of the comparison to a nibble of a 64-bit mask.
+      const auto mask {vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(found), 4)), 0)};
+
+      if (mask)
+      {
+        return first + (__builtin_ctzll(mask) >> 2);
+      }
+    }
+    #endif
+
+    for (; first != last; ++first)
+    {
+      if (is_control(static_cast<unsigned char>(*first)))
+      {
+        break;
+      }
+    }
+
+    return first;
+  }
+
+  // Returns the first byte with the high bit set in [first, last), or last.
+  inline const char* find_non_ascii(const char* first, const char* const last) noexcept
+  {
+    #if defined(__AVX2__)
+    for (; 32 <= last - first; first += 32)
+    {
+      const auto bytes {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first))};
+
+      if (const auto mask {static_cast<std::uint32_t>(_mm256_movemask_epi8(bytes))}; mask)
+      {
+        return first + __builtin_ctz(mask);
+      }
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    for (; 16 <= last - first; first += 16)
+    {
+      const auto bytes {_mm_loadu_si128(reinterpret_cast<const __m128i*>(first))};
+
+      if (const auto mask {static_cast<std::uint32_t>(_mm_movemask_epi8(bytes))}; mask)
+      {
+        return first + __builtin_ctz(mask);
+      }
+    }
+    #elif defined(__ARM_NEON)
+    for (; 16 <= last - first; first += 16)
+    {
+      const auto bytes {vld1q_u8(reinterpret_cast<const std::uint8_t*>(first))};
+
+      if (vmaxvq_u8(bytes) & 0x80)
+      {
+        break;
+      }
+    }
+    #endif
+
+    for (; first != last; ++first)
+    {
+      if (static_cast<unsigned char>(*first) & 0x80)
+      {
+        break;
+      }
+    }
+
+    return first;
+  }
+  /**
+   * Returns the first occurrence of needle in [first, last), or last. Blocks
+   * are filtered by comparing their bytes to the first byte of the needle and
+   * the bytes size - 1 further on to its last byte, and only positions that
+   * match both are compared in full, which in text is rarely more than one
+   * per block.
+   */
+  inline const char* find(const char* first, const char* const last, const std::string_view needle) noexcept
+  {
+    const auto size {needle.size()};
+
+    if (not size or static_cast<std::size_t>(last - first) < size)
+    {
+      return size ? last : first;
+    }
+
+    #if defined(__AVX2__)
+    for (const auto head {_mm256_set1_epi8(needle.front())}, tail {_mm256_set1_epi8(needle.back())}; 32 <= last - first - static_cast<std::ptrdiff_t>(size - 1); first += 32)
+    {
+      const auto found {_mm256_and_si256(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first)), head),
+        _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + size - 1)), tail)
+      )};
+
+      for (auto mask {static_cast<std::uint32_t>(_mm256_movemask_epi8(found))}; mask; mask &= mask - 1)
+      {
+        if (const auto* const at {first + __builtin_ctz(mask)}; std::memcmp(at, needle.data(), size) == 0)
+        {
+          return at;
+        }
+      }
+    }
+    #endif
+
+    #if defined(__SSE2__)
+    for (const auto head {_mm_set1_epi8(needle.front())}, tail {_mm_set1_epi8(needle.back())}; 16 <= last - first - static_cast<std::ptrdiff_t>(size - 1); first += 16)
+    {
+      const auto found {_mm_and_si128(
+        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), head),
+        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + size - 1)), tail)
+      )};
+
+      for (auto mask {static_cast<std::uint32_t>(_mm_movemask_epi8(found))}; mask; mask &= mask - 1)
+      {
+        if (const auto* const at {first + __builtin_ctz(mask)}; std::memcmp(at, needle.data(), size) == 0)
+        {
+          return at;
+        }
+      }
+    }
+    #elif defined(__ARM_NEON)
+    for (const auto head {vdupq_n_u8(static_cast<std::uint8_t>(needle.front()))}, tail {vdupq_n_u8(static_cast<std::uint8_t>(needle.back()))}; 16 <= last - first - static_cast<std::ptrdiff_t>(size - 1); first += 16)
+    {
+      const auto found {vandq_u8(
+        vceqq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t*>(first)), head),
+        vceqq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t*>(first + size - 1)), tail)
+      )};
+
+      // A nibble per byte, as in find_control().
+      for (auto mask {vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(found), 4)), 0)}; mask; mask &= ~(std::uint64_t {0xF} << __builtin_ctzll(mask)))
+      {
+        if (const auto* const at {first + (__builtin_ctzll(mask) >> 2)}; std::memcmp(at, needle.data(), size) == 0)
+        {
+          return at;
+        }
+      }
+    }
+    #endif
+
+    for (; static_cast<std::size_t>(last - first) >= size; ++first)
+    {
+      if (*first == needle.front() and std::memcmp(first, needle.data(), size) == 0)
+      {
+        return first;
+      }
+    }
+
+    return last;
+  }
+} // namespace vt10x::simd
+
+#endif // INCLUDED_VT10X_SIMD_HPP
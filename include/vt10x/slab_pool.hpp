@@ -0,0 +1,162 @@
+#ifndef INCLUDED_VT10X_SLAB_POOL_HPP
+#define INCLUDED_VT10X_SLAB_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vt10x
+{
+  /**
+   * Memory for objects made and dropped at a steady rate, such as the blocks
+   * of the scrollback, recycled through free lists instead of going back to
+   * the general purpose allocator. Sizes are rounded up to a multiple of the
+   * granule, each multiple with a list of its own, so once the pool has
+   * grown to the most of each that are alive at a time, taking one costs a
+   * lock and two pointers. Sizes over the largest are not pooled.
+   *
+   * Any thread may give memory back: a block of the scrollback dies on the
+   * thread of whichever search held it last.
+   */
+  class slab_pool
+  {
+    struct slab
+    {
+      slab* next;
+    };
+
+    const std::size_t granule, classes;
+
+    std::vector<slab*> free; // of each class, the smallest first
+
+    std::mutex guard {};
+
+    std::size_t rounded(const std::size_t size) const noexcept
+    {
+      return (size + granule - 1) / granule;
+    }
+
+  public:
+    explicit slab_pool(const std::size_t granule, const std::size_t largest)
+      : granule {(granule + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)}
+      , classes {rounded(largest)}
+      , free(classes, nullptr)
+    {}
+
+    slab_pool(const slab_pool&) = delete;
+    slab_pool& operator=(const slab_pool&) = delete;
+
+    ~slab_pool()
+    {
+      for (auto* each : free)
+      {
+        while (auto* const next {each})
+        {
+          each = next->next;
+          ::operator delete(next);
+        }
+      }
+    }
+
+    void* allocate(const std::size_t size)
+    {
+      const auto multiple {rounded(size ? size : 1)};
+
+      if (classes < multiple)
+      {
+        return ::operator new(size);
+      }
+
+      {
+        const std::lock_guard<std::mutex> lock {guard};
+
+        if (auto*& head {free[multiple - 1]}; head)
+        {
+          return std::exchange(head, head->next);
+        }
+      }
+
+      return ::operator new(multiple * granule);
+    }
+
+    void deallocate(void* const pointer, const std::size_t size) noexcept
+    {
+      const auto multiple {rounded(size ? size : 1)};
+
+      if (classes < multiple)
+      {
+        ::operator delete(pointer);
+        return;
+      }
+
+      const std::lock_guard<std::mutex> lock {guard};
+
+      auto*& head {free[multiple - 1]};
+      head = new (pointer) slab {head};
+    }
+
+    /**
+     * Allocator of a shared pool, for containers and std::allocate_shared.
+     * The pool lives as long as anything it gave out; a default constructed
+     * allocator has none and uses the general purpose one.
+     */
+    template <typename T>
+    class allocator
+    {
+      template <typename>
+      friend class allocator;
+
+      std::shared_ptr<slab_pool> pool;
+
+    public:
+      using value_type = T;
+
+      using propagate_on_container_move_assignment = std::true_type;
+      using propagate_on_container_swap = std::true_type;
+
+      allocator() noexcept = default;
+
+      explicit allocator(std::shared_ptr<slab_pool> pool) noexcept
+        : pool {std::move(pool)}
+      {}
+
+      template <typename U>
+      allocator(const allocator<U>& other) noexcept
+        : pool {other.pool}
+      {}
+
+      T* allocate(const std::size_t count)
+      {
+        return static_cast<T*>(pool ? pool->allocate(count * sizeof(T)) : ::operator new(count * sizeof(T)));
+      }
+
+      void deallocate(T* const pointer, const std::size_t count) noexcept
+      {
+        if (pool)
+        {
+          pool->deallocate(pointer, count * sizeof(T));
+        }
+        else
+        {
+          ::operator delete(pointer);
+        }
+      }
+
+      friend bool operator==(const allocator& lhs, const allocator& rhs) noexcept
+      {
+        return lhs.pool == rhs.pool;
+      }
+
+      friend bool operator!=(const allocator& lhs, const allocator& rhs) noexcept
+      {
+        return lhs.pool != rhs.pool;
+      }
+    };
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SLAB_POOL_HPP
@@ -0,0 +1,99 @@
+#ifndef INCLUDED_VT10X_SNAPSHOT_HPP
+#define INCLUDED_VT10X_SNAPSHOT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vt10x/attribute.hpp>
+#include <vt10x/screen.hpp>
+
+namespace vt10x
+{
+  /**
+   * What changed on a screen since it was last captured: the damaged rows
+   * with their spans, the cursor, and the attribute table when it may have
+   * changed. Applying it to a copy of the screen brings that copy up to date
+   * and leaves the same damage on it.
+   */
+  struct snapshot
+  {
+    std::size_t rows {0}, columns {0};
+
+    vt10x::cursor cursor {0, 0, 0, false, true};
+
+    std::vector<std::uint32_t> indices {}; // of the damaged rows
+
+    std::vector<span> spans {};
+
+    std::vector<cell> cells {}; // the damaged rows, one after another
+
+    bool with_attributes {false};
+
+    attribute_table attributes {};
+
+    unsigned modes {0}; // of the terminal, as terminal::modes()
+
+    bool synchronized {false}; // as terminal::synchronized
+
+    std::chrono::steady_clock::time_point read {}; // earliest PTY read it carries
+
+    // Takes the damage of source, which is repaired afterwards.
+    void capture(screen& source, const bool attributes_changed)
+    {
+      rows = source.rows();
+      columns = source.columns();
+      cursor = source.cursor;
+
+      indices.clear();
+      spans.clear();
+      cells.clear();
+
+      for (std::size_t row {0}; row < rows; ++row)
+      {
+        if (const auto damage {source.damage(row)}; not damage.empty())
+        {
+          indices.push_back(static_cast<std::uint32_t>(row));
+          spans.push_back(damage);
+          cells.insert(cells.end(), source.line(row), source.line(row) + columns);
+        }
+      }
+
+      // Switching to the alternate screen damages every row and brings in a
+      // different table, possibly of the same size.
+      with_attributes = attributes_changed or indices.size() == rows;
+
+      if (with_attributes)
+      {
+        attributes = source.attributes;
+      }
+
+      source.repair();
+    }
+
+    void apply(screen& target) const
+    {
+      if (target.rows() != rows or target.columns() != columns)
+      {
+        target.resize(rows, columns);
+      }
+
+      for (std::size_t index {0}; index < indices.size(); ++index)
+      {
+        std::copy_n(cells.begin() + index * columns, columns, target.line(indices[index]));
+        target.damage(indices[index], spans[index].first, spans[index].last);
+      }
+
+      target.cursor = cursor;
+
+      if (with_attributes)
+      {
+        target.attributes = attributes;
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SNAPSHOT_HPP
@@ -0,0 +1,70 @@
+#ifndef INCLUDED_VT10X_SPSC_RING_HPP
+#define INCLUDED_VT10X_SPSC_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace vt10x
+{
+  /**
+   * Bounded lock-free queue between exactly one producer and one consumer
+   * thread. Slots are filled and read in place, so elements keep their
+   * storage (e.g. the capacity of their vectors) from one round to the next.
+   */
+  template <typename T, std::size_t N>
+  class spsc_ring
+  {
+    static_assert(N and not (N & (N - 1)), "capacity must be a power of 2");
+
+    static constexpr std::size_t cache_line {64};
+
+    std::array<T, N> slots {};
+
+    // Each index is written by one side only; keeping them on separate cache
+    // lines stops the two threads from invalidating each other on every push.
+    alignas(cache_line) std::atomic<std::size_t> head {0}; // next to read
+    alignas(cache_line) std::atomic<std::size_t> tail {0}; // next to write
+
+  public:
+    // Producer: the slot to fill next, or nullptr if the ring is full.
+    T* claim() noexcept
+    {
+      const auto index {tail.load(std::memory_order_relaxed)};
+
+      if (index - head.load(std::memory_order_acquire) == N)
+      {
+        return nullptr;
+      }
+
+      return &slots[index % N];
+    }
+
+    // Producer: makes the claimed slot visible to the consumer.
+    void publish() noexcept
+    {
+      tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: the oldest published slot, or nullptr if the ring is empty.
+    T* peek() noexcept
+    {
+      const auto index {head.load(std::memory_order_relaxed)};
+
+      if (index == tail.load(std::memory_order_acquire))
+      {
+        return nullptr;
+      }
+
+      return &slots[index % N];
+    }
+
+    // Consumer: hands the peeked slot back to the producer.
+    void release() noexcept
+    {
+      head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_SPSC_RING_HPP
@@ -0,0 +1,270 @@
+#ifndef INCLUDED_VT10X_STATISTICS_HPP
+#define INCLUDED_VT10X_STATISTICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <vt10x/listener.hpp>
+#include <vt10x/notifier.hpp>
+
+namespace vt10x
+{
+  using counter = std::atomic<std::uint64_t>;
+
+  /**
+   * Latency distribution in power of two buckets of microseconds: bucket i
+   * counts samples in [2^(i-1), 2^i) us. Recording is a few relaxed atomic
+   * increments, so any thread may record while another reports.
+   */
+  class histogram
+  {
+    std::array<counter, 32> buckets {};
+
+    counter count {0}, sum {0}, max {0}; // in microseconds
+
+  public:
+    template <typename Duration>
+    void record(const Duration duration) noexcept
+    {
+      const auto us {static_cast<std::uint64_t>(std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(duration).count()))};
+
+      buckets[std::min<std::size_t>(us ? 64 - __builtin_clzll(us) : 0, buckets.size() - 1)].fetch_add(1, std::memory_order_relaxed);
+
+      count.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(us, std::memory_order_relaxed);
+
+      for (auto last {max.load(std::memory_order_relaxed)}; last < us and not max.compare_exchange_weak(last, us, std::memory_order_relaxed); );
+    }
+
+    // Upper bound of the bucket holding the q-quantile, in microseconds, but
+    // never above the maximum.
+    std::uint64_t quantile(const double q) const noexcept
+    {
+      const auto total {count.load(std::memory_order_relaxed)}, most {max.load(std::memory_order_relaxed)};
+
+      std::uint64_t seen {0};
+
+      for (std::size_t index {0}; index < buckets.size(); ++index)
+      {
+        if (seen += buckets[index].load(std::memory_order_relaxed); total and q * total <= seen)
+        {
+          return std::min(std::uint64_t {1} << index, most);
+        }
+      }
+
+      return most;
+    }
+
+    void report(std::string& out, const char* const name) const
+    {
+      const auto total {count.load(std::memory_order_relaxed)};
+
+      char line[256];
+
+      std::snprintf(
+        line, sizeof(line), "%s: count %llu mean %lluus p50 <%lluus p90 <%lluus p99 <%lluus max %lluus\n",
+        name,
+        static_cast<unsigned long long>(total),
+        static_cast<unsigned long long>(total ? sum.load(std::memory_order_relaxed) / total : 0),
+        static_cast<unsigned long long>(quantile(0.5)),
+        static_cast<unsigned long long>(quantile(0.9)),
+        static_cast<unsigned long long>(quantile(0.99)),
+        static_cast<unsigned long long>(max.load(std::memory_order_relaxed))
+      );
+
+      out += line;
+    }
+  };
+
+  struct statistics
+  {
+    const std::chrono::steady_clock::time_point started {std::chrono::steady_clock::now()};
+
+    histogram key_to_write {};    // key press dequeued to its bytes written to the PTY
+    histogram read_to_present {}; // first PTY read after a frame to the next presented frame
+
+    counter bytes {0}, reads {0};
+
+    counter frames_rendered {0}, frames_empty {0}, frames_deferred {0}, frames_busy {0};
+
+    counter flushes {0};
+
+    std::array<counter, 128> events {}; // transferred, by response type
+
+    std::string report() const
+    {
+      const auto elapsed {std::chrono::duration<double> {std::chrono::steady_clock::now() - started}.count()};
+
+      const auto load = [](const counter& value)
+      {
+        return static_cast<unsigned long long>(value.load(std::memory_order_relaxed));
+      };
+
+      std::string out {};
+
+      char line[256];
+
+      std::snprintf(
+        line, sizeof(line), "uptime: %.3fs\nparsed: %llu bytes in %llu reads, %.3f MB/s\n",
+        elapsed, load(bytes), load(reads), elapsed ? load(bytes) / elapsed / 1e6 : 0.0
+      );
+      out += line;
+
+      std::snprintf(
+        line, sizeof(line), "frames: %llu rendered, %llu empty, %llu deferred, %llu busy\nflushes: %llu\n",
+        load(frames_rendered), load(frames_empty), load(frames_deferred), load(frames_busy), load(flushes)
+      );
+      out += line;
+
+      key_to_write.report(out, "key to write");
+      read_to_present.report(out, "read to present");
+
+      out += "events:";
+
+      for (std::size_t type {0}; type < events.size(); ++type)
+      {
+        if (const auto count {load(events[type])}; count)
+        {
+          std::snprintf(line, sizeof(line), " %zu=%llu", type, count);
+          out += line;
+        }
+      }
+
+      out += '\n';
+
+      return out;
+    }
+  };
+
+  inline statistics stats {};
+
+  /**
+   * Writes stats.report() to stderr on SIGUSR1, and to every client that
+   * connects to an optional UNIX socket, from a thread of its own.
+   *
+   * SIGUSR1 is received through a signalfd, so it must be blocked in every
+   * thread: call block() before any thread is started.
+   */
+  class stats_reporter
+  {
+    const int signals;
+
+    std::optional<vt10x::listener> clients {};
+
+    notifier stop {};
+
+    std::thread thread;
+
+  public:
+    static void block() noexcept
+    {
+      sigset_t set;
+      sigemptyset(&set);
+      sigaddset(&set, SIGUSR1);
+      pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    }
+
+    explicit stats_reporter(const std::string& path = {})
+      : signals {make_signalfd()}
+    {
+      if (not path.empty())
+      {
+        clients.emplace(path);
+      }
+
+      thread = std::thread {[this]() { run(); }};
+    }
+
+    stats_reporter(const stats_reporter&) = delete;
+    stats_reporter& operator=(const stats_reporter&) = delete;
+
+    ~stats_reporter()
+    {
+      stop.signal();
+      thread.join();
+
+      close(signals);
+    }
+
+  private:
+    static int make_signalfd()
+    {
+      sigset_t set;
+      sigemptyset(&set);
+      sigaddset(&set, SIGUSR1);
+
+      if (const auto fd {signalfd(-1, &set, SFD_CLOEXEC)}; 0 <= fd)
+      {
+        return fd;
+      }
+
+      throw std::system_error {errno, std::generic_category(), "signalfd"};
+    }
+
+    static void send(const int fd, const std::string& report) noexcept
+    {
+      for (std::size_t written {0}; written < report.size(); )
+      {
+        if (const auto size {write(fd, report.data() + written, report.size() - written)}; 0 < size)
+        {
+          written += size;
+        }
+        else if (size < 0 and errno == EINTR)
+        {
+          continue;
+        }
+        else
+        {
+          break;
+        }
+      }
+    }
+
+    void run()
+    {
+      pollfd descriptors[] {
+        {stop.descriptor(), POLLIN, 0}, {signals, POLLIN, 0}, {clients ? clients->descriptor() : -1, POLLIN, 0},
+      };
+
+      while (0 <= poll(descriptors, clients ? 3 : 2, -1) or errno == EINTR)
+      {
+        if (descriptors[0].revents)
+        {
+          return;
+        }
+
+        if (descriptors[1].revents & POLLIN)
+        {
+          signalfd_siginfo info {};
+          static_cast<void>(read(signals, &info, sizeof(info)));
+          send(STDERR_FILENO, stats.report());
+        }
+
+        if (clients and descriptors[2].revents & POLLIN)
+        {
+          if (const auto client {clients->accept()}; 0 <= client)
+          {
+            send(client, stats.report());
+            close(client);
+          }
+        }
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_STATISTICS_HPP
@@ -0,0 +1,841 @@
+#ifndef INCLUDED_VT10X_TERMINAL_HPP
+#define INCLUDED_VT10X_TERMINAL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vt10x/attribute.hpp>
+#include <vt10x/keymap.hpp>
+#include <vt10x/parser.hpp>
+#include <vt10x/screen.hpp>
+#include <vt10x/simd.hpp>
+#include <vt10x/utf8.hpp>
+#include <vt10x/width.hpp>
+
+namespace vt10x
+{
+  // https://vt100.net/docs/vt220-rm/table2-4.html
+  constexpr char32_t special_graphics[] {
+    U'◆', U'▒', U'␉', U'␌', U'␍', U'␊', U'°', U'±',
+    U'␤', U'␋', U'┘', U'┐', U'┌', U'└', U'┼', U'⎺',
+    U'⎻', U'─', U'⎼', U'⎽', U'├', U'┤', U'┴', U'┬',
+    U'│', U'≤', U'≥', U'π', U'≠', U'£', U'·',
+  };
+
+  /**
+   * The emulator: applies what the parser recognizes to the screen. Replies
+   * to the host (device attributes, cursor position reports) are appended to
+   * response, which the owner of the PTY writes back and clears.
+   */
+  class terminal
+    : public parser<terminal>
+  {
+    friend class parser<terminal>;
+
+    vt10x::screen alternate;
+
+    struct saved_cursor
+    {
+      vt10x::cursor cursor;
+      attribute pen;
+      bool graphics, origin;
+    } saved;
+
+    std::vector<bool> tabs;
+
+    utf8_decoder decoder;
+
+  public:
+    vt10x::scrollback history;
+
+    vt10x::screen screen;
+
+    attribute pen;
+
+    std::string response;
+
+    bool graphics; // G0 designated as DEC special graphics
+
+    bool origin;   // DECOM: cursor addressing relative to the scrolling region
+
+    bool application_cursor, application_keypad, bracketed_paste, alternative;
+
+    // Mode 2026: the application is in the middle of drawing a frame, which
+    // should not be presented until it ends.
+    bool synchronized;
+
+    explicit terminal(const std::size_t rows = screen::default_rows, const std::size_t columns = screen::default_columns)
+      : alternate {rows, columns}
+      , saved {}
+      , tabs {}
+      , decoder {}
+      , history {}
+      , screen {rows, columns}
+      , pen {color::default_, color::default_, 0}
+      , response {}
+      , graphics {false}
+      , origin {false}
+      , application_cursor {false}
+      , application_keypad {false}
+      , bracketed_paste {false}
+      , alternative {false}
+      , synchronized {false}
+    {
+      screen.history = &history;
+      reset_tabs();
+    }
+
+    // Rewraps the primary screen; full screen programs redraw the alternate
+    // one anyway once told of the size.
+    void resize(const std::size_t rows, const std::size_t columns)
+    {
+      if (rows == screen.rows() and columns == screen.columns())
+      {
+        return;
+      }
+
+      (alternative ? alternate : screen).reflow(rows, columns);
+      (alternative ? screen : alternate).resize(rows, columns);
+      reset_tabs();
+    }
+
+    // The modes that change what keys and pastes send, as key_mode bits.
+    unsigned modes() const noexcept
+    {
+      return (application_cursor ? key_mode::application_cursor : 0u) | (application_keypad ? key_mode::application_keypad : 0u) | (bracketed_paste ? key_mode::bracketed_paste : 0u);
+    }
+
+  protected:
+    // Printable runs are mostly ASCII, which is copied into the row directly;
+    // anything else goes through the UTF-8 decoder one character at a time.
+    void print(const char* first, const char* const last)
+    {
+      while (first != last)
+      {
+        if (not decoder.pending())
+        {
+          if (const auto ascii {simd::find_non_ascii(first, last)}; ascii != first)
+          {
+            print_ascii(first, ascii);
+            first = ascii;
+            continue;
+          }
+        }
+
+        first = decoder.decode(first, last, [this](const char32_t codepoint)
+        {
+          write(codepoint);
+        });
+      }
+    }
+
+    void execute(const char byte)
+    {
+      interrupt();
+
+      switch (byte)
+      {
+      case '\b':
+        if (0 < screen.cursor.column)
+        {
+          --screen.cursor.column;
+        }
+        screen.cursor.pending_wrap = false;
+        break;
+
+      case '\t':
+        tab(1);
+        break;
+
+      case '\n':
+      case '\v':
+      case '\f':
+        screen.index();
+        break;
+
+      case '\r':
+        screen.carriage_return();
+        break;
+
+      default: // BEL, SO, SI and the others have no effect on the screen
+        break;
+      }
+    }
+
+    void esc_dispatch(const std::string_view intermediates, const char final)
+    {
+      interrupt();
+
+      if (intermediates.empty()) switch (final)
+      {
+      case 'D': // IND
+        screen.index();
+        break;
+
+      case 'E': // NEL
+        screen.carriage_return();
+        screen.index();
+        break;
+
+      case 'H': // HTS
+        tabs[screen.cursor.column] = true;
+        break;
+
+      case 'M': // RI
+        screen.reverse_index();
+        break;
+
+      case '7': // DECSC
+        save_cursor();
+        break;
+
+      case '8': // DECRC
+        restore_cursor();
+        break;
+
+      case '=': // DECKPAM
+        application_keypad = true;
+        break;
+
+      case '>': // DECKPNM
+        application_keypad = false;
+        break;
+
+      case 'c': // RIS
+        hard_reset();
+        break;
+      }
+      else if (intermediates == "(") // SCS for G0
+      {
+        graphics = final == '0';
+      }
+      else if (intermediates == "#" and final == '8') // DECALN
+      {
+        for (std::size_t row {0}; row < screen.rows(); ++row)
+        {
+          std::fill_n(screen.line(row), screen.columns(), cell {U'E', 0, 0});
+        }
+        screen.damage_all();
+      }
+    }
+
+    void csi_dispatch(const vt10x::parameters& parameters, const std::string_view intermediates, const char final)
+    {
+      interrupt();
+
+      auto& cursor {screen.cursor};
+
+      const auto n {parameters(0, 1)};
+
+      if (intermediates == "?") switch (final)
+      {
+      case 'h': // DECSET
+      case 'l': // DECRST
+        for (std::size_t index {0}; index < std::max<std::size_t>(parameters.size, 1); ++index)
+        {
+          set_private_mode(parameters[index], final == 'h');
+        }
+        break;
+      }
+      else if (intermediates == "?$" and final == 'p') // DECRQM
+      {
+        response += "\x1B[?" + std::to_string(parameters[0]) + ";" + std::to_string(private_mode(parameters[0])) + "$y";
+      }
+      else if (intermediates == ">" and final == 'c') // DA2
+      {
+        response += "\x1B[>0;10;0c";
+      }
+      else if (intermediates.empty()) switch (final)
+      {
+      case '@': // ICH
+        insert_characters(n);
+        break;
+
+      case 'A': // CUU
+        {
+          const auto limit {cursor.row < screen.top ? 0 : screen.top};
+          move_to(cursor.row - std::min<std::size_t>(n, cursor.row - limit), cursor.column, false);
+        }
+        break;
+
+      case 'B': // CUD
+      case 'e': // VPR
+        {
+          const auto limit {screen.bottom <= cursor.row ? screen.rows() : screen.bottom};
+          move_to(std::min<std::size_t>(cursor.row + n, limit - 1), cursor.column, false);
+        }
+        break;
+
+      case 'C': // CUF
+      case 'a': // HPR
+        move_to(cursor.row, cursor.column + n, false);
+        break;
+
+      case 'D': // CUB
+        move_to(cursor.row, cursor.column - std::min<std::size_t>(n, cursor.column), false);
+        break;
+
+      case 'E': // CNL, as CUD to the first column
+        {
+          const auto limit {screen.bottom <= cursor.row ? screen.rows() : screen.bottom};
+          move_to(std::min<std::size_t>(cursor.row + n, limit - 1), 0, false);
+        }
+        break;
+
+      case 'F': // CPL, as CUU to the first column
+        {
+          const auto limit {cursor.row < screen.top ? 0 : screen.top};
+          move_to(cursor.row - std::min<std::size_t>(n, cursor.row - limit), 0, false);
+        }
+        break;
+
+      case 'G': // CHA
+      case '`': // HPA
+        move_to(cursor.row, n - 1, false);
+        break;
+
+      case 'H': // CUP
+      case 'f': // HVP
+        move_to(n - 1, parameters(1, 1) - 1, origin);
+        break;
+
+      case 'I': // CHT
+        tab(n);
+        break;
+
+      case 'J': // ED
+        erase_in_display(parameters[0]);
+        break;
+
+      case 'K': // EL
+        erase_in_line(parameters[0]);
+        break;
+
+      case 'L': // IL
+        scroll_region_from_cursor(n, false);
+        break;
+
+      case 'M': // DL
+        scroll_region_from_cursor(n, true);
+        break;
+
+      case 'P': // DCH
+        delete_characters(n);
+        break;
+
+      case 'S': // SU
+        screen.scroll_up(n);
+        break;
+
+      case 'T': // SD
+        screen.scroll_down(n);
+        break;
+
+      case 'X': // ECH
+        screen.erase(cursor.row, cursor.column, cursor.column + n);
+        break;
+
+      case 'Z': // CBT
+        for (auto count {n}; count and 0 < cursor.column; --count)
+        {
+          do
+          {
+            --cursor.column;
+          }
+          while (0 < cursor.column and not tabs[cursor.column]);
+        }
+        break;
+
+      case 'c': // DA
+        response += "\x1B[?62;22c";
+        break;
+
+      case 'd': // VPA
+        move_to(n - 1, cursor.column, origin);
+        break;
+
+      case 'g': // TBC
+        if (parameters[0] == 3)
+        {
+          std::fill(std::begin(tabs), std::end(tabs), false);
+        }
+        else if (parameters[0] == 0)
+        {
+          tabs[cursor.column] = false;
+        }
+        break;
+
+      case 'h': // SM
+      case 'l': // RM
+        break;
+
+      case 'm': // SGR
+        select_graphic_rendition(parameters);
+        break;
+
+      case 'n': // DSR
+        if (parameters[0] == 5)
+        {
+          response += "\x1B[0n";
+        }
+        else if (parameters[0] == 6)
+        {
+          const auto row {origin ? cursor.row - screen.top : cursor.row};
+          response += "\x1B[" + std::to_string(row + 1) + ";" + std::to_string(cursor.column + 1) + "R";
+        }
+        break;
+
+      case 'r': // DECSTBM
+        {
+          const std::size_t top {parameters(0, 1) - 1};
+          const std::size_t bottom {std::min<std::size_t>(parameters(1, screen.rows()), screen.rows())};
+
+          if (top + 1 < bottom)
+          {
+            screen.top = top;
+            screen.bottom = bottom;
+            move_to(0, 0, origin);
+          }
+        }
+        break;
+
+      case 's': // SCOSC
+        save_cursor();
+        break;
+
+      case 'u': // SCORC
+        restore_cursor();
+        break;
+      }
+    }
+
+    // The synchronized update of iTerm2, older than mode 2026: DCS = 1 s ST
+    // begins one and DCS = 2 s ST ends it.
+    void hook(const vt10x::parameters& parameters, const std::string_view intermediates, const char final)
+    {
+      interrupt();
+
+      if (intermediates == "=" and final == 's' and (parameters[0] == 1 or parameters[0] == 2))
+      {
+        synchronized = parameters[0] == 1;
+      }
+    }
+
+    void osc_dispatch(const std::string_view)
+    {
+      interrupt();
+    }
+
+  private:
+    void print_ascii(const char* first, const char* const last) noexcept
+    {
+      while (first != last)
+      {
+        if (screen.cursor.pending_wrap)
+        {
+          screen.wrap();
+        }
+
+        auto* cells {screen.line(screen.cursor.row) + screen.cursor.column};
+
+        const auto size {std::min<std::size_t>(screen.columns() - screen.cursor.column, last - first)};
+
+        screen.split(screen.cursor.row, screen.cursor.column, screen.cursor.column + size);
+
+        for (std::size_t index {0}; index < size; ++index)
+        {
+          cells[index] = cell {translate(static_cast<unsigned char>(first[index])), screen.cursor.attribute, 0};
+        }
+
+        screen.damage(screen.cursor.row, screen.cursor.column, screen.cursor.column + size);
+
+        first += size;
+        screen.advance(size);
+      }
+    }
+
+    void write(const char32_t codepoint) noexcept
+    {
+      if (const auto columns {width(codepoint)}; columns) // combining marks are dropped
+      {
+        screen.put(codepoint, columns);
+      }
+    }
+
+    // A control in the middle of a multibyte sequence terminates it.
+    void interrupt() noexcept
+    {
+      decoder.interrupt([this](const char32_t codepoint)
+      {
+        write(codepoint);
+      });
+    }
+
+    char32_t translate(const unsigned char byte) const noexcept
+    {
+      return graphics and 0x60 <= byte and byte <= 0x7E ? special_graphics[byte - 0x60] : byte;
+    }
+
+    void reset_tabs()
+    {
+      tabs.assign(screen.columns(), false);
+
+      for (std::size_t column {8}; column < tabs.size(); column += 8)
+      {
+        tabs[column] = true;
+      }
+    }
+
+    void tab(std::size_t count) noexcept
+    {
+      auto& cursor {screen.cursor};
+
+      while (count-- and cursor.column + 1 < screen.columns())
+      {
+        do
+        {
+          ++cursor.column;
+        }
+        while (cursor.column + 1 < screen.columns() and not tabs[cursor.column]);
+      }
+    }
+
+    void move_to(std::size_t row, const std::size_t column, const bool relative) noexcept
+    {
+      if (relative)
+      {
+        row = std::min(row + screen.top, screen.bottom - 1);
+      }
+
+      screen.cursor.row = std::min(row, screen.rows() - 1);
+      screen.cursor.column = std::min(column, screen.columns() - 1);
+      screen.cursor.pending_wrap = false;
+    }
+
+    void erase_in_display(const std::uint32_t mode) noexcept
+    {
+      const auto& cursor {screen.cursor};
+
+      switch (mode)
+      {
+      case 0:
+        screen.erase(cursor.row, cursor.column, screen.columns());
+        for (auto row {cursor.row + 1}; row < screen.rows(); ++row)
+        {
+          screen.erase(row, 0, screen.columns());
+        }
+        break;
+
+      case 1:
+        for (std::size_t row {0}; row < cursor.row; ++row)
+        {
+          screen.erase(row, 0, screen.columns());
+        }
+        screen.erase(cursor.row, 0, cursor.column + 1);
+        break;
+
+      case 2:
+        for (std::size_t row {0}; row < screen.rows(); ++row)
+        {
+          screen.erase(row, 0, screen.columns());
+        }
+        break;
+
+      case 3: // xterm: the saved lines
+        history.clear();
+        break;
+      }
+    }
+
+    void erase_in_line(const std::uint32_t mode) noexcept
+    {
+      const auto& cursor {screen.cursor};
+
+      switch (mode)
+      {
+      case 0:
+        screen.erase(cursor.row, cursor.column, screen.columns());
+        break;
+
+      case 1:
+        screen.erase(cursor.row, 0, cursor.column + 1);
+        break;
+
+      case 2:
+        screen.erase(cursor.row, 0, screen.columns());
+        break;
+      }
+    }
+
+    void insert_characters(const std::size_t count) noexcept
+    {
+      auto* const first {screen.line(screen.cursor.row) + screen.cursor.column};
+      auto* const last {screen.line(screen.cursor.row) + screen.columns()};
+
+      const auto shift {std::min<std::size_t>(count, last - first)};
+
+      std::copy_backward(first, last - shift, last);
+      std::fill_n(first, shift, screen.blank());
+
+      screen.damage(screen.cursor.row, screen.cursor.column, screen.columns());
+    }
+
+    void delete_characters(const std::size_t count) noexcept
+    {
+      auto* const first {screen.line(screen.cursor.row) + screen.cursor.column};
+      auto* const last {screen.line(screen.cursor.row) + screen.columns()};
+
+      const auto shift {std::min<std::size_t>(count, last - first)};
+
+      std::copy(first + shift, last, first);
+      std::fill(last - shift, last, screen.blank());
+
+      screen.damage(screen.cursor.row, screen.cursor.column, screen.columns());
+    }
+
+    // IL and DL move the part of the region below the cursor, if it is in it.
+    void scroll_region_from_cursor(const std::size_t count, const bool up) noexcept
+    {
+      if (screen.top <= screen.cursor.row and screen.cursor.row < screen.bottom)
+      {
+        if (up)
+        {
+          screen.delete_lines(count);
+        }
+        else
+        {
+          screen.insert_lines(count);
+        }
+
+        screen.carriage_return();
+      }
+    }
+
+    // Interprets 38/48 extended colors in both ';' and ':' separated forms.
+    static std::uint32_t extended_color(const vt10x::parameters& parameters, std::size_t& index) noexcept
+    {
+      const auto colon {parameters.is_subparameter(index + 1)};
+
+      switch (parameters[index + 1])
+      {
+      case 5:
+        index += 2;
+        return color::indexed(static_cast<std::uint8_t>(parameters[index]));
+
+      case 2:
+        // 38:2:<colorspace>:r:g:b carries a (usually empty) colorspace id.
+        if (colon and parameters.is_subparameter(index + 5))
+        {
+          ++index;
+        }
+        index += 4;
+        return color::direct(
+          static_cast<std::uint8_t>(parameters[index - 2]),
+          static_cast<std::uint8_t>(parameters[index - 1]),
+          static_cast<std::uint8_t>(parameters[index])
+        );
+
+      default:
+        index = parameters.size;
+        return color::default_;
+      }
+    }
+
+    void select_graphic_rendition(const vt10x::parameters& parameters)
+    {
+      for (std::size_t index {0}; index < std::max<std::size_t>(parameters.size, 1); ++index)
+      {
+        switch (const auto value {parameters[index]}; value)
+        {
+        case 0:  pen = attribute {color::default_, color::default_, 0}; break;
+        case 1:  pen.style |= attribute::bold;      break;
+        case 2:  pen.style |= attribute::faint;     break;
+        case 3:  pen.style |= attribute::italic;    break;
+        case 4:
+          // 4:0 is no underline; the styles 4:1 to 4:5 are all drawn as one.
+          if (parameters.is_subparameter(index + 1) and not parameters[index + 1])
+          {
+            pen.style &= ~attribute::underline;
+          }
+          else
+          {
+            pen.style |= attribute::underline;
+          }
+          break;
+
+        case 5:  pen.style |= attribute::blink;     break;
+        case 7:  pen.style |= attribute::inverse;   break;
+        case 8:  pen.style |= attribute::invisible; break;
+        case 9:  pen.style |= attribute::strike;    break;
+        case 21: pen.style |= attribute::underline; break;
+        case 22: pen.style &= ~(attribute::bold | attribute::faint); break;
+        case 23: pen.style &= ~attribute::italic;    break;
+        case 24: pen.style &= ~attribute::underline; break;
+        case 25: pen.style &= ~attribute::blink;     break;
+        case 27: pen.style &= ~attribute::inverse;   break;
+        case 28: pen.style &= ~attribute::invisible; break;
+        case 29: pen.style &= ~attribute::strike;    break;
+        case 38: pen.foreground = extended_color(parameters, index); break;
+        case 39: pen.foreground = color::default_; break;
+        case 48: pen.background = extended_color(parameters, index); break;
+        case 49: pen.background = color::default_; break;
+
+        default:
+          if (30 <= value and value <= 37)
+          {
+            pen.foreground = color::indexed(value - 30);
+          }
+          else if (40 <= value and value <= 47)
+          {
+            pen.background = color::indexed(value - 40);
+          }
+          else if (90 <= value and value <= 97)
+          {
+            pen.foreground = color::indexed(value - 90 + 8);
+          }
+          else if (100 <= value and value <= 107)
+          {
+            pen.background = color::indexed(value - 100 + 8);
+          }
+          break;
+        }
+
+        // Sub-parameters left over belong to the code, never codes of their own.
+        while (parameters.is_subparameter(index + 1))
+        {
+          ++index;
+        }
+      }
+
+      screen.cursor.attribute = screen.intern(pen);
+    }
+
+    void set_private_mode(const std::uint32_t mode, const bool enable)
+    {
+      switch (mode)
+      {
+      case 1: // DECCKM
+        application_cursor = enable;
+        break;
+
+      case 6: // DECOM
+        origin = enable;
+        move_to(0, 0, origin);
+        break;
+
+      case 7: // DECAWM
+        screen.autowrap = enable;
+        alternate.autowrap = enable;
+        break;
+
+      case 25: // DECTCEM
+        screen.cursor.visible = enable;
+        break;
+
+      case 47:
+      case 1047:
+        switch_screen(enable);
+        break;
+
+      case 1048:
+        enable ? save_cursor() : restore_cursor();
+        break;
+
+      case 1049:
+        if (enable)
+        {
+          save_cursor();
+          switch_screen(true);
+          erase_in_display(2);
+        }
+        else
+        {
+          switch_screen(false);
+          restore_cursor();
+        }
+        break;
+
+      case 2004:
+        bracketed_paste = enable;
+        break;
+
+      case 2026:
+        synchronized = enable;
+        break;
+      }
+    }
+
+    // The state of a mode as DECRPM reports it: 1 set, 2 reset, 0 unknown.
+    unsigned private_mode(const std::uint32_t mode) const noexcept
+    {
+      const auto state = [](const bool set)
+      {
+        return set ? 1u : 2u;
+      };
+
+      switch (mode)
+      {
+      case 1:    return state(application_cursor);
+      case 6:    return state(origin);
+      case 7:    return state(screen.autowrap);
+      case 25:   return state(screen.cursor.visible);
+      case 47:
+      case 1047:
+      case 1049: return state(alternative);
+      case 2004: return state(bracketed_paste);
+      case 2026: return state(synchronized);
+      default:   return 0;
+      }
+    }
+
+    void switch_screen(const bool enable)
+    {
+      if (enable != alternative)
+      {
+        std::swap(screen, alternate);
+        screen.cursor = alternate.cursor;
+        screen.cursor.attribute = screen.intern(pen);
+        screen.damage_all();
+        alternative = enable;
+      }
+    }
+
+    void save_cursor() noexcept
+    {
+      saved = saved_cursor {screen.cursor, pen, graphics, origin};
+    }
+
+    void restore_cursor()
+    {
+      screen.cursor = saved.cursor;
+      screen.cursor.row = std::min(screen.cursor.row, screen.rows() - 1);
+      screen.cursor.column = std::min(screen.cursor.column, screen.columns() - 1);
+      pen = saved.pen;
+      graphics = saved.graphics;
+      origin = saved.origin;
+      screen.cursor.attribute = screen.intern(pen);
+    }
+
+    void hard_reset()
+    {
+      if (alternative)
+      {
+        switch_screen(false);
+      }
+
+      screen = vt10x::screen {screen.rows(), screen.columns()};
+      alternate = vt10x::screen {screen.rows(), screen.columns()};
+      screen.history = &history;
+      pen = attribute {color::default_, color::default_, 0};
+      graphics = origin = application_cursor = application_keypad = bracketed_paste = synchronized = false;
+      reset_tabs();
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_TERMINAL_HPP
@@ -0,0 +1,234 @@
+#ifndef INCLUDED_VT10X_UTF8_HPP
+#define INCLUDED_VT10X_UTF8_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <vt10x/simd.hpp>
+
+namespace vt10x
+{
+  // How the rest of a sequence is validated, indexed by its lead byte.
+  struct utf8_lead
+  {
+    std::uint8_t size, lower, upper, mask;
+  };
+
+  constexpr auto make_utf8_leads()
+  {
+    std::array<utf8_lead, 256> leads {};
+
+    for (auto byte {0xC2}; byte <= 0xDF; ++byte) leads[byte] = {1, 0x80, 0xBF, 0x1F};
+    for (auto byte {0xE1}; byte <= 0xEF; ++byte) leads[byte] = {2, 0x80, 0xBF, 0x0F};
+    for (auto byte {0xF1}; byte <= 0xF3; ++byte) leads[byte] = {3, 0x80, 0xBF, 0x07};
+
+    leads[0xE0] = {2, 0xA0, 0xBF, 0x0F}; // overlong
+    leads[0xED] = {2, 0x80, 0x9F, 0x0F}; // surrogates
+    leads[0xF0] = {3, 0x90, 0xBF, 0x07}; // overlong
+    leads[0xF4] = {3, 0x80, 0x8F, 0x07}; // beyond U+10FFFF
+
+    return leads;
+  }
+
+  inline constexpr auto utf8_leads {make_utf8_leads()};
+
+  // Writes 1 to 4 bytes at out, which is advanced past them.
+  inline void encode_utf8(const char32_t codepoint, char*& out) noexcept
+  {
+    if (codepoint < 0x80)
+    {
+      *out++ = static_cast<char>(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+      *out++ = static_cast<char>(0xC0 | codepoint >> 6);
+      *out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+      *out++ = static_cast<char>(0xE0 | codepoint >> 12);
+      *out++ = static_cast<char>(0x80 | (codepoint >> 6 & 0x3F));
+      *out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+      *out++ = static_cast<char>(0xF0 | codepoint >> 18);
+      *out++ = static_cast<char>(0x80 | (codepoint >> 12 & 0x3F));
+      *out++ = static_cast<char>(0x80 | (codepoint >> 6 & 0x3F));
+      *out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+  }
+
+  /**
+   * Incremental UTF-8 decoder. A sequence split across two reads is resumed
+   * on the next call; malformed input decodes to U+FFFD per maximal subpart,
+   * as recommended by Unicode 11 section 3.9.
+   */
+  class utf8_decoder
+  {
+    char32_t codepoint {0};
+
+    std::uint8_t remaining {0}, lower {0x80}, upper {0xBF};
+
+  public:
+    static constexpr char32_t replacement {U'�'};
+
+    auto pending() const noexcept
+    {
+      return 0 < remaining;
+    }
+
+    // Abandons an incomplete sequence, e.g. when a control interrupts it.
+    template <typename F>
+    void interrupt(F&& emit)
+    {
+      if (pending())
+      {
+        remaining = 0;
+        emit(replacement);
+      }
+    }
+
+    /**
+     * Decodes non-ASCII input, calling emit(codepoint) for each character.
+     * Stops at the first ASCII byte found on a character boundary, so that
+     * the caller can take its own ASCII fast path, and returns its position.
+     */
+    template <typename F>
+    const char* decode(const char* first, const char* const last, F&& emit)
+    {
+      while (first != last)
+      {
+        const auto byte {static_cast<unsigned char>(*first)};
+
+        if (pending())
+        {
+          if (lower <= byte and byte <= upper)
+          {
+            codepoint = codepoint << 6 | (byte & 0x3F);
+            lower = 0x80;
+            upper = 0xBF;
+            ++first;
+
+            if (not --remaining)
+            {
+              emit(codepoint);
+            }
+          }
+          else // byte is reprocessed as the start of the next character
+          {
+            remaining = 0;
+            emit(replacement);
+          }
+        }
+        else if (byte < 0x80)
+        {
+          break;
+        }
+        else if (const auto consumed {block(first, last, emit)}; consumed)
+        {
+          first += consumed;
+        }
+        else
+        {
+          if (const auto& entry {utf8_leads[byte]}; entry.size)
+          {
+            codepoint = byte & entry.mask;
+            remaining = entry.size;
+            lower = entry.lower;
+            upper = entry.upper;
+          }
+          else
+          {
+            emit(replacement);
+          }
+          ++first;
+        }
+      }
+
+      return first;
+    }
+
+  private:
+    /**
+     * Validates a 16 byte block at a character boundary that consists only of
+     * two byte sequences (Latin, Greek, Cyrillic...) or only of three byte
+     * sequences (CJK) with vector compares, then decodes it without further
+     * checks. Returns the number of bytes consumed, 0 if the block is of any
+     * other shape and should go through the byte-wise path.
+     */
+    template <typename F>
+    static std::size_t block(const char* const first, const char* const last, F&& emit)
+    {
+      #if defined(__SSE2__)
+      if (last - first < 16)
+      {
+        return 0;
+      }
+
+      const auto bytes {_mm_loadu_si128(reinterpret_cast<const __m128i*>(first))};
+
+      const auto continuation {static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xC0))) // signed: 0x80-0xBF
+      ))};
+
+      const auto* const lead {reinterpret_cast<const unsigned char*>(first)};
+
+      if (continuation == 0xAAAA)
+      {
+        const auto leads2 {static_cast<unsigned>(_mm_movemask_epi8(
+          _mm_cmpeq_epi8(_mm_and_si128(bytes, _mm_set1_epi8(static_cast<char>(0xE0))), _mm_set1_epi8(static_cast<char>(0xC0)))
+        ))};
+
+        const auto overlong {static_cast<unsigned>(_mm_movemask_epi8( // C0 and C1
+          _mm_cmpeq_epi8(_mm_and_si128(bytes, _mm_set1_epi8(static_cast<char>(0xFE))), _mm_set1_epi8(static_cast<char>(0xC0)))
+        ))};
+
+        if (leads2 == 0x5555 and not overlong)
+        {
+          for (auto index {0}; index < 16; index += 2)
+          {
+            emit(static_cast<char32_t>((lead[index] & 0x1F) << 6 | (lead[index + 1] & 0x3F)));
+          }
+          return 16;
+        }
+      }
+      else if ((continuation & 0x7FFF) == 0x6DB6)
+      {
+        const auto leads3 {static_cast<unsigned>(_mm_movemask_epi8(
+          _mm_cmpeq_epi8(_mm_and_si128(bytes, _mm_set1_epi8(static_cast<char>(0xF0))), _mm_set1_epi8(static_cast<char>(0xE0)))
+        ))};
+
+        const auto next {_mm_srli_si128(bytes, 1)};
+
+        const auto low {static_cast<unsigned>(_mm_movemask_epi8( // next byte <= 0x9F
+          _mm_cmpeq_epi8(_mm_min_epu8(next, _mm_set1_epi8(static_cast<char>(0x9F))), next)
+        ))};
+
+        const auto e0 {static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xE0)))))};
+        const auto ed {static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xED)))))};
+
+        if ((leads3 & 0x7FFF) == 0x1249 and not (e0 & low & 0x1249) and not (ed & ~low & 0x1249))
+        {
+          for (auto index {0}; index < 15; index += 3)
+          {
+            emit(static_cast<char32_t>(
+              (lead[index] & 0x0F) << 12 | (lead[index + 1] & 0x3F) << 6 | (lead[index + 2] & 0x3F)
+            ));
+          }
+          return 15;
+        }
+      }
+      #else
+      static_cast<void>(first);
+      static_cast<void>(last);
+      static_cast<void>(emit);
+      #endif
+
+      return 0;
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_UTF8_HPP
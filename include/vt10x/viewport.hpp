@@ -0,0 +1,349 @@
+#ifndef INCLUDED_VT10X_VIEWPORT_HPP
+#define INCLUDED_VT10X_VIEWPORT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <vt10x/cell.hpp>
+#include <vt10x/screen.hpp>
+#include <vt10x/scrollback.hpp>
+#include <vt10x/selection.hpp>
+#include <vt10x/utf8.hpp>
+
+namespace vt10x
+{
+  /**
+   * The screen as seen some rows back in the history. Lines are numbered as
+   * in the scrollback, and the rows of the screen follow its last one, so
+   * the top of the view is a line and a row of it: history lines wider than
+   * the screen are shown over as many rows as they need, however wide the
+   * screen was when they scrolled off. While scrolled back, the view keeps
+   * to the lines it shows as output goes on below it.
+   *
+   * view is what is drawn instead of the screen while scrolled(), which
+   * compose() brings up to date. As it reads the history, a viewport belongs
+   * to the thread that pushes to it.
+   */
+  class viewport
+  {
+    struct position
+    {
+      std::size_t number, row; // line, and row of it, at the top of the view
+    };
+
+    std::optional<position> top {};
+
+    std::vector<cell> line {};
+
+    bool stale {false};
+
+  public:
+    vt10x::screen view {};
+
+    bool scrolled() const noexcept
+    {
+      return top.has_value();
+    }
+
+    // Back to the screen itself, drawn whole as it was not while scrolled.
+    void reset(screen& live) noexcept
+    {
+      if (top)
+      {
+        top.reset();
+        live.damage_all();
+      }
+    }
+
+    // Scrolls by rows, back into the history if negative; false if that
+    // moved nothing.
+    bool scroll(const long rows, screen& live, const scrollback& history)
+    {
+      const auto end {history.first() + history.size()};
+
+      auto at {top ? clamp(*top, live, history) : position {end, 0}};
+
+      const auto before {at};
+
+      for (auto count {rows}; count < 0 and (at.row or history.first() < at.number); ++count)
+      {
+        if (at.row)
+        {
+          --at.row;
+        }
+        else
+        {
+          --at.number;
+          at.row = rows_of(at.number, live, history) - 1;
+        }
+      }
+
+      for (auto count {rows}; 0 < count and at.number < end; --count)
+      {
+        if (at.row + 1 < rows_of(at.number, live, history))
+        {
+          ++at.row;
+        }
+        else
+        {
+          ++at.number;
+          at.row = 0;
+        }
+      }
+
+      if (at.number == before.number and at.row == before.row)
+      {
+        return false;
+      }
+
+      if (at.number < end)
+      {
+        top = at;
+        stale = true;
+      }
+      else
+      {
+        reset(live);
+      }
+
+      return true;
+    }
+
+    /**
+     * Shows length bytes from offset of the text of line number of the
+     * history, as a search matches them, on the top row and those after it;
+     * returns where in view they are, nothing if the line was dropped.
+     */
+    std::optional<selection::region> reveal(const std::size_t number, const std::uint32_t offset, const std::uint32_t length, screen& live, const scrollback& history)
+    {
+      if (number < history.first() or history.first() + history.size() <= number)
+      {
+        return std::nullopt;
+      }
+
+      history.read(number - history.first(), line);
+
+      const auto first {at_byte(offset)}, last {at_byte(offset + std::max<std::uint32_t>(length, 1) - 1)};
+      const auto columns {live.columns()};
+
+      std::size_t row {0}, begins {0};
+
+      for (; next(begins, columns) <= first and next(begins, columns) < line.size(); begins = next(begins, columns))
+      {
+        ++row;
+      }
+
+      top = position {number, row};
+      stale = true;
+
+      selection::region region {{0, first - begins}, {0, 0}};
+
+      for (; next(begins, columns) <= last and next(begins, columns) < line.size(); begins = next(begins, columns))
+      {
+        ++region.last.row;
+      }
+
+      region.last.column = last - begins;
+
+      if (live.rows() <= region.last.row)
+      {
+        region.last = {live.rows() - 1, columns - 1};
+      }
+
+      return region;
+    }
+
+    // Fills view with the rows it shows, if they changed: the view moved, or
+    // the screen has damage, which is taken into the view as a whole.
+    void compose(screen& live, const scrollback& history)
+    {
+      if (not top)
+      {
+        return;
+      }
+
+      if (reset_unless_back(live, history); not top or not (stale or live.damaged()))
+      {
+        return;
+      }
+
+      if (view.rows() != live.rows() or view.columns() != live.columns())
+      {
+        view.resize(live.rows(), live.columns());
+      }
+
+      view.attributes = live.attributes;
+      view.cursor = live.cursor;
+      view.cursor.visible = false;
+
+      const auto end {history.first() + history.size()};
+      const auto columns {live.columns()};
+
+      auto at {*top};
+
+      for (std::size_t row {0}; row < view.rows(); ++row)
+      {
+        auto* const cells {view.line(row)};
+
+        if (at.number < end)
+        {
+          const auto index {at.number - history.first()};
+          const auto& table {history.attributes(index)};
+
+          history.read(index, line);
+
+          const auto first {begin(at.row, columns)}, last {std::min(line.size(), begin(at.row + 1, columns))};
+
+          std::fill(cells, cells + columns, cell {U' ', 0, 0});
+
+          for (auto column {first}; column < last; ++column)
+          {
+            cells[column - first] = line[column];
+            cells[column - first].attribute = view.attributes.intern(table[line[column].attribute]);
+            cells[column - first].flags &= ~cell::wrapped;
+          }
+
+          if (at.row + 1 < rows_of(columns))
+          {
+            ++at.row;
+          }
+          else
+          {
+            ++at.number;
+            at.row = 0;
+          }
+        }
+        else
+        {
+          const auto source {at.number++ - end};
+
+          std::copy_n(live.line(source), columns, cells);
+
+          if (source == live.cursor.row)
+          {
+            view.cursor.row = row;
+            view.cursor.visible = live.cursor.visible;
+          }
+        }
+      }
+
+      live.repair();
+      view.damage_all();
+      stale = false;
+    }
+
+  private:
+    // The cell of the line read last whose UTF-8 has the byte at offset in
+    // the text of the line, which leaves double width spacers out.
+    std::size_t at_byte(const std::uint32_t offset) const noexcept
+    {
+      std::uint32_t bytes {0};
+
+      for (std::size_t index {0}; index < line.size(); ++index)
+      {
+        if (not (line[index].flags & cell::wide_spacer))
+        {
+          char buffer[4];
+          auto* end {buffer};
+          encode_utf8(line[index].codepoint, end);
+
+          if (offset < (bytes += static_cast<std::uint32_t>(end - buffer)))
+          {
+            return index;
+          }
+        }
+      }
+
+      return line.empty() ? 0 : line.size() - 1;
+    }
+
+    // Where row of a line begins; double width characters are not split,
+    // which only a one column screen cannot keep to.
+    std::size_t begin(const std::size_t row, const std::size_t columns) const noexcept
+    {
+      std::size_t offset {0};
+
+      for (std::size_t count {0}; count < row and offset < line.size(); ++count)
+      {
+        offset = next(offset, columns);
+      }
+
+      return offset;
+    }
+
+    std::size_t next(const std::size_t offset, const std::size_t columns) const noexcept
+    {
+      auto end {std::min(line.size(), offset + columns)};
+
+      if (end < line.size() and line[end].flags & cell::wide_spacer and offset + 1 < end)
+      {
+        --end;
+      }
+
+      return end;
+    }
+
+    // Rows the line read last takes on a screen of that many columns, at
+    // least one.
+    std::size_t rows_of(const std::size_t columns) const noexcept
+    {
+      std::size_t rows {1};
+
+      for (auto offset {next(0, columns)}; offset < line.size(); offset = next(offset, columns))
+      {
+        ++rows;
+      }
+
+      return rows;
+    }
+
+    std::size_t rows_of(const std::size_t number, const screen& live, const scrollback& history)
+    {
+      if (history.first() + history.size() <= number)
+      {
+        return 1;
+      }
+
+      history.read(number - history.first(), line);
+
+      return rows_of(live.columns());
+    }
+
+    // The top brought within what the history still keeps and the screen
+    // is now, e.g. after the oldest lines were dropped or a resize.
+    position clamp(position at, const screen& live, const scrollback& history)
+    {
+      if (at.number < history.first())
+      {
+        at = {history.first(), 0};
+      }
+
+      if (at.number < history.first() + history.size())
+      {
+        at.row = std::min(at.row, rows_of(at.number, live, history) - 1);
+      }
+
+      return at;
+    }
+
+    // Clamps the top, back to the screen itself once the history ran out
+    // under it, as a clear of the history does.
+    void reset_unless_back(screen& live, const scrollback& history)
+    {
+      if (const auto at {clamp(*top, live, history)}; at.number < history.first() + history.size())
+      {
+        stale = stale or at.number != top->number or at.row != top->row;
+        top = at;
+      }
+      else
+      {
+        reset(live);
+      }
+    }
+  };
+} // namespace vt10x
+
+#endif // INCLUDED_VT10X_VIEWPORT_HPP
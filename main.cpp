@@ -1,15 +1,24 @@
 #include <algorithm>
+#include <array>
 #include <cerrno>
+#include <climits> // PATH_MAX
 #include <cstdint> // std::uint32_t
-#include <iostream>
+#include <cstdlib> // std::free, std::getenv
+#include <cstring> // std::strlen
+#include <functional>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -19,53 +28,30 @@
 #include <xcb/xcb.h>
 #include <xcb/xcb_keysyms.h>
 
-#ifndef NDEBUG
-#define PRINT(NAME, ...) std::cerr << #NAME __VA_ARGS__ << std::endl;
-#else
-#define PRINT(NAME, ...)
-#endif // NDEBUG
+#include <vt10x/back_buffer.hpp>
+#include <vt10x/frame_scheduler.hpp>
+#ifdef VT10X_GLES
+#include <vt10x/gles_renderer.hpp>
+#endif
+#include <vt10x/keysym.hpp>
+#include <vt10x/listener.hpp>
+#include <vt10x/log.hpp>
+#include <vt10x/paste.hpp>
+#include <vt10x/parse_thread.hpp>
+#include <vt10x/pseudo_terminal.hpp>
+#include <vt10x/reactor.hpp>
+#include <vt10x/renderer.hpp>
+#include <vt10x/search.hpp>
+#include <vt10x/selection.hpp>
+#include <vt10x/statistics.hpp>
+#include <vt10x/terminal.hpp>
+#include <vt10x/viewport.hpp>
+
+const auto* font {"Monospace:pixelsize=14:antialias=true:autohint=true"};
+const auto* name {"vt10x-256color"};
 
 namespace xcb
 {
-  struct shared_connection
-    : public std::shared_ptr<xcb_connection_t>
-  {
-    explicit shared_connection()
-      : std::shared_ptr<xcb_connection_t> {xcb_connect(nullptr, nullptr), xcb_disconnect}
-    {
-      if (const auto state {xcb_connection_has_error(*this)}; state) switch (state)
-      {
-      case XCB_CONN_ERROR:
-        throw std::runtime_error {"socket errors, pipe errors or other stream errors"};
-
-      case XCB_CONN_CLOSED_EXT_NOTSUPPORTED:
-        throw std::runtime_error {"extension not supported"};
-
-      case XCB_CONN_CLOSED_MEM_INSUFFICIENT:
-        throw std::runtime_error {"memory not available"};
-
-      case XCB_CONN_CLOSED_REQ_LEN_EXCEED:
-        throw std::runtime_error {"exceeding request length that server accepts"};
-
-      case XCB_CONN_CLOSED_PARSE_ERR:
-        throw std::runtime_error {"error during parsing display string"};
-
-      case XCB_CONN_CLOSED_INVALID_SCREEN:
-        throw std::runtime_error {"the server does not have a screen matching the display"};
-      }
-    }
-
-    operator xcb_connection_t*() const noexcept
-    {
-      return get();
-    }
-
-    decltype(auto) flush() const noexcept
-    {
-      return xcb_flush(*this);
-    }
-  };
-
   #define XCB_ITERATOR(NAME)                                                   \
   class iterator                                                               \
     : public xcb_##NAME##_iterator_t                                           \
@@ -163,39 +149,214 @@ namespace xcb
   XCB_PROTOCOL(screen, depth, allowed_depths)
   XCB_PROTOCOL(depth, visualtype, visuals)
 
-  auto root_screen(const shared_connection& connection)
+  /**
+   * The connection, with what every window needs from it: looked up once from
+   * the setup, or requested at connect time and collected on first use, so
+   * all those replies arrive in one round trip that overlaps the rest of the
+   * startup.
+   */
+  struct shared_connection
+    : public std::shared_ptr<xcb_connection_t>
   {
-    return std::begin(setups {xcb_get_setup(connection)})->root;
-  }
+    enum atom : std::size_t
+    {
+      wm_protocols, wm_delete_window, net_wm_name, net_wm_pid, utf8_string, targets, incr, text, vt10x_selection, atom_count
+    };
 
-  // XXX cairo_xcb_surface_create requires non-const xcb_visualtype_t*
-  auto root_visual(const shared_connection& connection)
-  {
-    for (const auto& screen : setups {xcb_get_setup(connection)})
+    enum extension : std::size_t
     {
-      for (const auto& depth : screens {&screen})
+      present, xkb, extension_count
+    };
+
+    const xcb_screen_t* screen {nullptr}; // that of the display, as the root window
+
+    int number {0}; // of screen, e.g. 1 for DISPLAY=:0.1
+
+    // XXX cairo_xcb_surface_create requires non-const xcb_visualtype_t*
+    xcb_visualtype_t* visual {nullptr}; // of the root window
+
+  private:
+    static constexpr std::string_view atom_names[atom_count] {
+      "WM_PROTOCOLS", "WM_DELETE_WINDOW", "_NET_WM_NAME", "_NET_WM_PID", "UTF8_STRING", "TARGETS", "INCR", "TEXT", "VT10X_SELECTION",
+    };
+
+    static constexpr std::string_view extension_names[extension_count] {
+      "Present", "XKEYBOARD",
+    };
+
+    std::array<xcb_intern_atom_cookie_t, atom_count> atom_cookies {};
+
+    std::array<xcb_query_extension_cookie_t, extension_count> extension_cookies {};
+
+    mutable std::array<xcb_atom_t, atom_count> atoms {};
+
+    mutable std::array<bool, extension_count> extensions {};
+
+    mutable bool collected {false};
+
+    // The screen of the display comes back alongside the connection.
+    explicit shared_connection(const std::pair<xcb_connection_t*, int>& connected)
+      : std::shared_ptr<xcb_connection_t> {connected.first, xcb_disconnect}
+      , number {connected.second}
+    {
+      if (const auto state {xcb_connection_has_error(*this)}; state) switch (state)
+      {
+      case XCB_CONN_ERROR:
+        throw std::runtime_error {"socket errors, pipe errors or other stream errors"};
+
+      case XCB_CONN_CLOSED_EXT_NOTSUPPORTED:
+        throw std::runtime_error {"extension not supported"};
+
+      case XCB_CONN_CLOSED_MEM_INSUFFICIENT:
+        throw std::runtime_error {"memory not available"};
+
+      case XCB_CONN_CLOSED_REQ_LEN_EXCEED:
+        throw std::runtime_error {"exceeding request length that server accepts"};
+
+      case XCB_CONN_CLOSED_PARSE_ERR:
+        throw std::runtime_error {"error during parsing display string"};
+
+      case XCB_CONN_CLOSED_INVALID_SCREEN:
+        throw std::runtime_error {"the server does not have a screen matching the display"};
+      }
+
+      auto position {0};
+
+      for (const auto& root : setups {xcb_get_setup(*this)})
       {
-        for (auto&& visual : depths {&depth})
+        if (position++ != number)
+        {
+          continue;
+        }
+
+        screen = &root;
+
+        for (const auto& depth : screens {&root})
         {
-          if (screen.root_visual == visual.visual_id)
+          for (auto&& each : depths {&depth})
           {
-            return &visual;
+            if (root.root_visual == each.visual_id and not visual)
+            {
+              visual = &each;
+            }
           }
         }
+
+        break;
+      }
+
+      for (std::size_t index {0}; index < atom_count; ++index)
+      {
+        atom_cookies[index] = xcb_intern_atom(*this, false, atom_names[index].size(), atom_names[index].data());
+      }
+
+      for (std::size_t index {0}; index < extension_count; ++index)
+      {
+        extension_cookies[index] = xcb_query_extension(*this, extension_names[index].size(), extension_names[index].data());
+      }
+
+      // Replies xcb caches for itself, wanted by back_buffer.
+      xcb_prefetch_extension_data(*this, &xcb_shm_id);
+      xcb_prefetch_maximum_request_length(*this);
+
+      xcb_flush(*this);
+    }
+
+    static std::pair<xcb_connection_t*, int> connect()
+    {
+      int number {0};
+      auto* const connection {xcb_connect(nullptr, &number)};
+      return {connection, number};
+    }
+
+  public:
+    explicit shared_connection()
+      : shared_connection {connect()}
+    {}
+
+    xcb_atom_t operator[](const atom which) const
+    {
+      collect();
+      return atoms[which];
+    }
+
+    bool has(const extension which) const
+    {
+      collect();
+      return extensions[which];
+    }
+
+    operator xcb_connection_t*() const noexcept
+    {
+      return get();
+    }
+
+    decltype(auto) flush() const noexcept
+    {
+      return xcb_flush(*this);
+    }
+
+  private:
+    void collect() const
+    {
+      if (std::exchange(collected, true))
+      {
+        return;
+      }
+
+      for (std::size_t index {0}; index < atom_count; ++index)
+      {
+        const std::unique_ptr<xcb_intern_atom_reply_t, decltype(&std::free)> reply {
+          xcb_intern_atom_reply(*this, atom_cookies[index], nullptr), std::free
+        };
+
+        atoms[index] = reply ? reply->atom : xcb_atom_t {XCB_ATOM_NONE};
       }
+
+      for (std::size_t index {0}; index < extension_count; ++index)
+      {
+        const std::unique_ptr<xcb_query_extension_reply_t, decltype(&std::free)> reply {
+          xcb_query_extension_reply(*this, extension_cookies[index], nullptr), std::free
+        };
+
+        extensions[index] = reply and reply->present;
+      }
+
+      vt10x::log::info("connection; shm {} present {} xkb {}", xcb_get_extension_data(*this, &xcb_shm_id)->present, extensions[present], extensions[xkb]);
+    }
+  };
+
+  auto root_screen(const shared_connection& connection)
+  {
+    return connection.screen->root;
+  }
+
+  auto root_visual(const shared_connection& connection)
+  {
+    if (not connection.visual)
+    {
+      throw std::runtime_error {"there is no root visualtype"};
     }
 
-    throw std::runtime_error {"there is no root visualtype"};
+    return connection.visual;
   }
 
   // http://manpages.ubuntu.com/manpages/bionic/man3/xcb_create_window.3.html
   struct identity
   {
-    static inline const shared_connection connection {};
+    // Opened by the first window instead of at load time, so that nothing
+    // connects to a display unless a window is created.
+    static const shared_connection& shared()
+    {
+      static const shared_connection connection {};
+      return connection;
+    }
+
+    const shared_connection& connection {shared()};
 
     const xcb_window_t value;
 
-    explicit identity(const xcb_window_t& parent = root_screen(connection))
+    explicit identity(const xcb_window_t& parent = root_screen(shared()))
       : value {xcb_generate_id(connection)}
     {
       xcb_create_window(
@@ -230,27 +391,61 @@ namespace xcb
       return xcb_unmap_window(connection, value);
     }
 
+    // Titles the window and asks to be told of its closing rather than being
+    // disconnected: the first use of the atoms collects their replies.
+    void title(const std::string_view text, const std::string_view instance = "vt10x") const
+    {
+      const std::uint32_t pid {static_cast<std::uint32_t>(getpid())};
+      const xcb_atom_t protocols[] {connection[shared_connection::wm_delete_window]};
+
+      std::string classes {instance};
+      classes += '\0';
+      classes += "Vt10x";
+      classes += '\0';
+
+      xcb_change_property(connection, XCB_PROP_MODE_REPLACE, value, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, text.size(), text.data());
+      xcb_change_property(connection, XCB_PROP_MODE_REPLACE, value, connection[shared_connection::net_wm_name], connection[shared_connection::utf8_string], 8, text.size(), text.data());
+      xcb_change_property(connection, XCB_PROP_MODE_REPLACE, value, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8, classes.size(), classes.data());
+      xcb_change_property(connection, XCB_PROP_MODE_REPLACE, value, connection[shared_connection::net_wm_pid], XCB_ATOM_CARDINAL, 32, 1, &pid);
+      xcb_change_property(connection, XCB_PROP_MODE_REPLACE, value, connection[shared_connection::wm_protocols], XCB_ATOM_ATOM, 32, std::size(protocols), protocols);
+    }
+
+    // Value lists live on the stack: their length is that of the pack.
     template <typename... Ts>
     decltype(auto) configure(const std::uint16_t mask, Ts&&... configurations) const
     {
-      const std::vector<std::uint32_t> values {std::forward<decltype(configurations)>(configurations)...};
+      const std::array<std::uint32_t, sizeof...(Ts)> values {static_cast<std::uint32_t>(configurations)...};
       return xcb_configure_window(connection, value, mask, values.data());
     }
 
     template <typename Mask, typename... Ts>
     decltype(auto) change_attributes(const Mask& mask, Ts&&... attributes) const
     {
-      const std::vector<std::uint32_t> values {std::forward<decltype(attributes)>(attributes)...};
+      const std::array<std::uint32_t, sizeof...(Ts)> values {static_cast<std::uint32_t>(attributes)...};
       return xcb_change_window_attributes(connection, value, mask, values.data());
     }
   };
 
+  // libxcb allocates events with malloc(3).
+  struct free_event
+  {
+    void operator()(xcb_generic_event_t* const event) const noexcept
+    {
+      std::free(event);
+    }
+  };
+
+  /**
+   * Owns one event from libxcb until the next poll. Handlers borrow it as a
+   * reference to its concrete type, so an event costs nothing beyond the
+   * allocation libxcb made for it, freed once.
+   */
   struct event
-    : public std::unique_ptr<xcb_generic_event_t>
+    : public std::unique_ptr<xcb_generic_event_t, free_event>
   {
     template <typename... Ts>
     explicit event(Ts&&... operands)
-      : std::unique_ptr<xcb_generic_event_t> {std::forward<decltype(operands)>(operands)...}
+      : std::unique_ptr<xcb_generic_event_t, free_event> {std::forward<decltype(operands)>(operands)...}
     {}
 
     auto type() const noexcept
@@ -264,259 +459,1471 @@ namespace xcb
       return *this;
     }
 
+    decltype(auto) poll(const shared_connection& connection)
+    {
+      reset(xcb_poll_for_event(connection));
+      return *this;
+    }
+
+    decltype(auto) poll_queued(const shared_connection& connection)
+    {
+      reset(xcb_poll_for_queued_event(connection));
+      return *this;
+    }
+
     template <typename T>
-    auto release_as()
+    auto as() const noexcept
     {
-      return std::unique_ptr<T> {reinterpret_cast<T*>(release())};
+      return reinterpret_cast<T*>(get());
     }
   };
 
-  template <typename Surface, auto EventMask>
-  struct machine
-    : public identity
+  /**
+   * Core events as (response type, name, event mask bits any of which select
+   * it). Events without bits are sent regardless of the mask.
+   */
+  #define XCB_CORE_EVENTS(EVENT)                                               \
+  EVENT(XCB_KEY_PRESS,         key_press,         XCB_EVENT_MASK_KEY_PRESS)    \
+  EVENT(XCB_KEY_RELEASE,       key_release,       XCB_EVENT_MASK_KEY_RELEASE)  \
+  EVENT(XCB_BUTTON_PRESS,      button_press,      XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_OWNER_GRAB_BUTTON) \
+  EVENT(XCB_BUTTON_RELEASE,    button_release,    XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_OWNER_GRAB_BUTTON) \
+  EVENT(XCB_MOTION_NOTIFY,     motion_notify,     XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_POINTER_MOTION_HINT | XCB_EVENT_MASK_BUTTON_MOTION | XCB_EVENT_MASK_BUTTON_1_MOTION | XCB_EVENT_MASK_BUTTON_2_MOTION | XCB_EVENT_MASK_BUTTON_3_MOTION | XCB_EVENT_MASK_BUTTON_4_MOTION | XCB_EVENT_MASK_BUTTON_5_MOTION) \
+  EVENT(XCB_ENTER_NOTIFY,      enter_notify,      XCB_EVENT_MASK_ENTER_WINDOW) \
+  EVENT(XCB_LEAVE_NOTIFY,      leave_notify,      XCB_EVENT_MASK_LEAVE_WINDOW) \
+  EVENT(XCB_FOCUS_IN,          focus_in,          XCB_EVENT_MASK_FOCUS_CHANGE) \
+  EVENT(XCB_FOCUS_OUT,         focus_out,         XCB_EVENT_MASK_FOCUS_CHANGE) \
+  EVENT(XCB_KEYMAP_NOTIFY,     keymap_notify,     XCB_EVENT_MASK_KEYMAP_STATE) \
+  EVENT(XCB_EXPOSE,            expose,            XCB_EVENT_MASK_EXPOSURE)     \
+  EVENT(XCB_GRAPHICS_EXPOSURE, graphics_exposure, 0)                           \
+  EVENT(XCB_NO_EXPOSURE,       no_exposure,       0)                           \
+  EVENT(XCB_VISIBILITY_NOTIFY, visibility_notify, XCB_EVENT_MASK_VISIBILITY_CHANGE) \
+  EVENT(XCB_CREATE_NOTIFY,     create_notify,     XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_DESTROY_NOTIFY,    destroy_notify,    XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_UNMAP_NOTIFY,      unmap_notify,      XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_MAP_NOTIFY,        map_notify,        XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_MAP_REQUEST,       map_request,       XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT) \
+  EVENT(XCB_REPARENT_NOTIFY,   reparent_notify,   XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_CONFIGURE_NOTIFY,  configure_notify,  XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_CONFIGURE_REQUEST, configure_request, XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT) \
+  EVENT(XCB_GRAVITY_NOTIFY,    gravity_notify,    XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_RESIZE_REQUEST,    resize_request,    XCB_EVENT_MASK_RESIZE_REDIRECT) \
+  EVENT(XCB_CIRCULATE_NOTIFY,  circulate_notify,  XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY) \
+  EVENT(XCB_CIRCULATE_REQUEST, circulate_request, XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT) \
+  EVENT(XCB_PROPERTY_NOTIFY,   property_notify,   XCB_EVENT_MASK_PROPERTY_CHANGE) \
+  EVENT(XCB_SELECTION_CLEAR,   selection_clear,   0)                           \
+  EVENT(XCB_SELECTION_REQUEST, selection_request, 0)                           \
+  EVENT(XCB_SELECTION_NOTIFY,  selection_notify,  0)                           \
+  EVENT(XCB_COLORMAP_NOTIFY,   colormap_notify,   XCB_EVENT_MASK_COLOR_MAP_CHANGE) \
+  EVENT(XCB_CLIENT_MESSAGE,    client_message,    0)                           \
+  EVENT(XCB_MAPPING_NOTIFY,    mapping_notify,    0)                           \
+  EVENT(XCB_GE_GENERIC,        ge_generic,        0)
+
+  /**
+   * When requests buffered by xcb are written to the server. Each flush is a
+   * writev(2) and a wakeup of the X server, which is a round trip under remote
+   * X, so the coarser the policy the fewer of them per second.
+   */
+  enum class flush_policy
   {
-    template <typename... Ts>
-    explicit machine(Ts&&... operands)
-      : identity {std::forward<decltype(operands)>(operands)...}
-    {}
+    event,     // after every transferred event
+    iteration, // once per reactor iteration, before going to sleep
+    frame,     // once per presented frame, and on explicit flush_now()
+  };
+
+  /**
+   * The PRIMARY selection of a window, both ways, as ICCCM 2 has it; the
+   * window selects property changes for itself.
+   *
+   * Owned, the text is serialized when another client asks for it, at most
+   * a chunk per property write: more than a chunk goes INCR, the next chunk
+   * being written whenever the requestor deletes the last, so a selection of
+   * any size costs a chunk of memory per transfer.
+   *
+   * Requested, the text arrives the same way and goes to a paste. The next
+   * chunk is fetched only once the paste has written most of what it holds,
+   * so that the owner, not this process, holds the rest of a huge paste.
+   */
+  class clipboard
+  {
+    const shared_connection& connection;
 
-    #define TRANSFER_EVENT(EVENT_NAME)                                           \
-    if constexpr (std::is_invocable<                                             \
-                    Surface, std::unique_ptr<xcb_##EVENT_NAME##_event_t>         \
-                  >::value)                                                      \
-    {                                                                            \
-      PRINT(EVENT_NAME, "")                                                      \
-      static_cast<Surface&>(*this)(                                              \
-        event.release_as<xcb_##EVENT_NAME##_event_t>()                           \
-      );                                                                         \
-    }                                                                            \
-    else                                                                         \
-    {                                                                            \
-      PRINT(EVENT_NAME, " (unimplemented)")                                      \
-    }                                                                            \
-    break;
+    const xcb_window_t window;
 
-    void execute()
+    std::shared_ptr<const vt10x::selection> owned {};
+
+    xcb_timestamp_t since {XCB_CURRENT_TIME};
+
+    struct transfer
     {
-      change_attributes(XCB_CW_EVENT_MASK, EventMask);
-      connection.flush();
+      xcb_window_t requestor;
 
-      for (event event {nullptr}; event.wait(connection); connection.flush())
-      {
-        #ifndef NDEBUG
-        std::cerr << "; execution\t; sequence " << event->sequence << " on " << this << ", ";
-        #endif
+      xcb_atom_t property, type;
 
-        switch (event.type())
-        {
-        case XCB_KEY_PRESS:                                                  //  2
-          TRANSFER_EVENT(key_press)
+      std::shared_ptr<const vt10x::selection> text; // which a new selection does not replace
+
+      vt10x::selection::reader reader;
+    };
 
-        case XCB_KEY_RELEASE:                                                //  3
-          TRANSFER_EVENT(key_release)
+    std::vector<transfer> transfers {};
+
+    enum class receiving
+    {
+      nothing, conversion, increments
+    };
 
-        case XCB_BUTTON_PRESS:                                               //  4
-          TRANSFER_EVENT(button_press)
+    receiving incoming {receiving::nothing};
 
-        case XCB_BUTTON_RELEASE:                                             //  5
-          TRANSFER_EVENT(button_release)
+    bool bracketed {false}, stalled {false};
 
-        case XCB_MOTION_NOTIFY:                                              //  6
-          TRANSFER_EVENT(motion_notify)
+    std::string chunk {};
 
-        case XCB_ENTER_NOTIFY:                                               //  7
-          TRANSFER_EVENT(enter_notify)
+    const std::size_t chunk_size;
 
-        case XCB_LEAVE_NOTIFY:                                               //  8
-          TRANSFER_EVENT(leave_notify)
+  public:
+    // Requestors that vanish mid-transfer never say so; the oldest of more
+    // transfers than this is dropped.
+    static constexpr std::size_t transfer_limit {16};
 
-        case XCB_FOCUS_IN:                                                   //  9
-          TRANSFER_EVENT(focus_in)
+    static constexpr std::size_t backlog_limit {1 << 20};
 
-        case XCB_FOCUS_OUT:                                                  // 10
-          TRANSFER_EVENT(focus_out)
+    explicit clipboard(const shared_connection& connection, const xcb_window_t window)
+      : connection {connection}
+      , window {window}
+      , chunk_size {std::min<std::size_t>(256 * 1024, xcb_get_maximum_request_length(connection) * 4 - 64)}
+    {}
 
-        case XCB_KEYMAP_NOTIFY:                                              // 11
-          TRANSFER_EVENT(keymap_notify)
+    // Takes PRIMARY with text, as of the user action at time.
+    void own(std::shared_ptr<const vt10x::selection> text, const xcb_timestamp_t time)
+    {
+      owned = std::move(text);
+      since = time;
 
-        case XCB_EXPOSE:                                                     // 12
-          TRANSFER_EVENT(expose)
+      xcb_set_selection_owner(connection, window, XCB_ATOM_PRIMARY, time);
+    }
 
-        case XCB_GRAPHICS_EXPOSURE:                                          // 13
-          TRANSFER_EVENT(graphics_exposure)
+    // Transfers begun go on with the text they began with.
+    void operator()(const xcb_selection_clear_event_t&) noexcept
+    {
+      owned.reset();
+    }
 
-        case XCB_NO_EXPOSURE:                                                // 14
-          TRANSFER_EVENT(no_exposure)
+    void operator()(const xcb_selection_request_event_t& event)
+    {
+      // Obsolete requestors leave the property to the owner.
+      const auto property {event.property == XCB_ATOM_NONE ? event.target : event.property};
+
+      xcb_selection_notify_event_t reply {};
+      reply.response_type = XCB_SELECTION_NOTIFY;
+      reply.time = event.time;
+      reply.requestor = event.requestor;
+      reply.selection = event.selection;
+      reply.target = event.target;
+      reply.property = XCB_ATOM_NONE;
+
+      if (owned and event.selection == XCB_ATOM_PRIMARY and (event.time == XCB_CURRENT_TIME or since <= event.time) and answer(event.requestor, property, event.target))
+      {
+        reply.property = property;
+      }
 
-        case XCB_VISIBILITY_NOTIFY:                                          // 15
-          TRANSFER_EVENT(visibility_notify)
+      // An event of 32 bytes, of which the notify has fewer.
+      char bytes[32] {};
+      std::memcpy(bytes, &reply, sizeof(reply));
 
-        case XCB_CREATE_NOTIFY:                                              // 16
-          TRANSFER_EVENT(create_notify)
+      xcb_send_event(connection, false, event.requestor, XCB_EVENT_MASK_NO_EVENT, bytes);
+    }
 
-        case XCB_DESTROY_NOTIFY:                                             // 17
-          TRANSFER_EVENT(destroy_notify)
+    // Asks the owner of PRIMARY for its text, which goes to the paste passed
+    // along with the events that follow.
+    void request(const xcb_timestamp_t time, const bool bracketed)
+    {
+      xcb_convert_selection(connection, window, XCB_ATOM_PRIMARY, connection[shared_connection::utf8_string], connection[shared_connection::vt10x_selection], time);
 
-        case XCB_UNMAP_NOTIFY:                                               // 18
-          TRANSFER_EVENT(unmap_notify)
+      incoming = receiving::conversion;
+      this->bracketed = bracketed;
+      stalled = false;
+    }
 
-        case XCB_MAP_NOTIFY:                                                 // 19
-          TRANSFER_EVENT(map_notify)
+    void operator()(const xcb_selection_notify_event_t& event, vt10x::paste& paste)
+    {
+      if (incoming != receiving::conversion or event.requestor != window)
+      {
+        return;
+      }
 
-        case XCB_MAP_REQUEST:                                                // 20
-          TRANSFER_EVENT(map_request)
+      if (event.property != XCB_ATOM_NONE)
+      {
+        fetch(paste);
+      }
+      else if (event.target == connection[shared_connection::utf8_string]) // an owner older than UTF-8
+      {
+        xcb_convert_selection(connection, window, XCB_ATOM_PRIMARY, XCB_ATOM_STRING, connection[shared_connection::vt10x_selection], event.time);
+      }
+      else
+      {
+        incoming = receiving::nothing;
+      }
+    }
 
-        case XCB_REPARENT_NOTIFY:                                            // 21
-          TRANSFER_EVENT(reparent_notify)
+    void operator()(const xcb_property_notify_event_t& event, vt10x::paste& paste)
+    {
+      if (event.state == XCB_PROPERTY_DELETE)
+      {
+        const auto each {std::find_if(transfers.begin(), transfers.end(), [&](const auto& each)
+        {
+          return each.requestor == event.window and each.property == event.atom;
+        })};
 
-        case XCB_CONFIGURE_NOTIFY:                                           // 22
-          TRANSFER_EVENT(configure_notify)
+        if (each != transfers.end())
+        {
+          read(each->reader);
 
-        case XCB_CONFIGURE_REQUEST:                                          // 23
-          TRANSFER_EVENT(configure_request)
+          // Of no length, the last write ends the transfer.
+          xcb_change_property(connection, XCB_PROP_MODE_REPLACE, each->requestor, each->property, each->type, 8, chunk.size(), chunk.data());
 
-        case XCB_GRAVITY_NOTIFY:                                             // 24
-          TRANSFER_EVENT(gravity_notify)
+          if (chunk.empty())
+          {
+            xcb_change_window_attributes(connection, each->requestor, XCB_CW_EVENT_MASK, std::array<std::uint32_t, 1> {XCB_EVENT_MASK_NO_EVENT}.data());
+            transfers.erase(each);
+          }
+        }
+      }
+      else if (incoming == receiving::increments and event.window == window and event.atom == connection[shared_connection::vt10x_selection])
+      {
+        if (paste.backlog() < backlog_limit)
+        {
+          fetch(paste);
+        }
+        else
+        {
+          stalled = true;
+        }
+      }
+    }
 
-        case XCB_RESIZE_REQUEST:                                             // 25
-          TRANSFER_EVENT(resize_request)
+    // Fetches the chunk held back while the paste was behind.
+    void resume(vt10x::paste& paste)
+    {
+      if (stalled and paste.backlog() < backlog_limit)
+      {
+        stalled = false;
+        fetch(paste);
+      }
+    }
 
-        case XCB_CIRCULATE_NOTIFY:                                           // 26
-          TRANSFER_EVENT(circulate_notify)
+  private:
+    // Converts the text owned to target, into property of requestor; false
+    // if it cannot.
+    bool answer(const xcb_window_t requestor, const xcb_atom_t property, const xcb_atom_t target)
+    {
+      const auto utf8 {connection[shared_connection::utf8_string]};
 
-        case XCB_CIRCULATE_REQUEST:                                          // 27
-          TRANSFER_EVENT(circulate_request)
+      if (target == connection[shared_connection::targets])
+      {
+        const xcb_atom_t supported[] {connection[shared_connection::targets], utf8, connection[shared_connection::text], XCB_ATOM_STRING};
 
-        case XCB_PROPERTY_NOTIFY:                                            // 28
-          TRANSFER_EVENT(property_notify)
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, requestor, property, XCB_ATOM_ATOM, 32, std::size(supported), supported);
+        return true;
+      }
 
-        case XCB_SELECTION_CLEAR:                                            // 29
-          TRANSFER_EVENT(selection_clear)
+      if (target != utf8 and target != connection[shared_connection::text] and target != XCB_ATOM_STRING)
+      {
+        return false;
+      }
 
-        case XCB_SELECTION_REQUEST:                                          // 30
-          TRANSFER_EVENT(selection_request)
+      // STRING gets UTF-8 too, as terminals have always sent it.
+      const auto type {target == XCB_ATOM_STRING ? xcb_atom_t {XCB_ATOM_STRING} : utf8};
 
-        case XCB_SELECTION_NOTIFY:                                           // 31
-          TRANSFER_EVENT(selection_notify)
+      vt10x::selection::reader reader {*owned};
 
-        case XCB_COLORMAP_NOTIFY:                                            // 32
-          TRANSFER_EVENT(colormap_notify)
+      if (read(reader); reader.done())
+      {
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, requestor, property, type, 8, chunk.size(), chunk.data());
+        return true;
+      }
 
-        case XCB_CLIENT_MESSAGE:                                             // 33
-          TRANSFER_EVENT(client_message)
+      const std::uint32_t bound {static_cast<std::uint32_t>(chunk.size())}; // a lower bound of the size
 
-        case XCB_MAPPING_NOTIFY:                                             // 34
-          TRANSFER_EVENT(mapping_notify)
+      xcb_change_window_attributes(connection, requestor, XCB_CW_EVENT_MASK, std::array<std::uint32_t, 1> {XCB_EVENT_MASK_PROPERTY_CHANGE}.data());
+      xcb_change_property(connection, XCB_PROP_MODE_REPLACE, requestor, property, connection[shared_connection::incr], 32, 1, &bound);
 
-        case XCB_GE_GENERIC:                                                 // 35
-          TRANSFER_EVENT(ge_generic)
-        }
+      if (transfers.size() == transfer_limit)
+      {
+        transfers.erase(transfers.begin());
       }
-    }
-  };
 
-  template <typename Char>
-  class keyboard
-  {
-    std::unique_ptr<xcb_key_symbols_t, decltype(&xcb_key_symbols_free)> symbols;
+      // The requestor deleting the INCR property asks for the first chunk.
+      transfers.push_back(transfer {requestor, property, type, owned, vt10x::selection::reader {*owned}});
 
-  public:
-    explicit keyboard(const shared_connection& connection)
-      : symbols {xcb_key_symbols_alloc(connection), xcb_key_symbols_free}
-    {}
+      vt10x::log::info("clipboard; incremental transfer to {}", requestor);
+      return true;
+    }
 
-    auto press(const std::unique_ptr<xcb_key_press_event_t> event)
+    // The next chunk of reader, into chunk.
+    void read(vt10x::selection::reader& reader)
     {
-      auto code {xcb_key_press_lookup_keysym(
-        symbols.get(),
-        event.get(),
-        event->state & ~XCB_MOD_MASK_CONTROL
-      )};
+      chunk.resize(chunk_size);
+      chunk.resize(reader.read(chunk.data(), chunk.size()));
+    }
 
-      if (xcb_is_modifier_key(code))
+    // Reads and deletes the property, which holds the whole text, its next
+    // chunk or the INCR that announces chunks; the deletion asks for the next.
+    void fetch(vt10x::paste& paste)
+    {
+      const std::unique_ptr<xcb_get_property_reply_t, decltype(&std::free)> reply {
+        xcb_get_property_reply(connection, xcb_get_property(connection, true, window, connection[shared_connection::vt10x_selection], XCB_GET_PROPERTY_TYPE_ANY, 0, UINT32_MAX / 4), nullptr), std::free
+      };
+
+      if (not reply or reply->type == XCB_ATOM_NONE)
       {
-        return false;
+        paste.end();
+        incoming = receiving::nothing;
+        return;
       }
 
-      switch (event->state)
-      {
-      case XCB_MOD_MASK_CONTROL:
-      case XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_SHIFT:
-        switch (code)
-        {
-        #define DEBUG_KEYCODE(CODE, ...) \
-        std::cerr << "; keybord\t; caret " #CODE " - " __VA_ARGS__ << std::endl;
-
-        case '@': DEBUG_KEYCODE(0x00, "null")                      break;
-        case 'A': DEBUG_KEYCODE(0x01, "start-of-heading")          break;
-        case 'B': DEBUG_KEYCODE(0x02, "start-of-text")             break;
-        case 'C': DEBUG_KEYCODE(0x03, "end-of-text")               break;
-        case 'D': DEBUG_KEYCODE(0x04, "end-of-transmission")       break;
-        case 'E': DEBUG_KEYCODE(0x05, "enquiry")                   break;
-        case 'F': DEBUG_KEYCODE(0x06, "acknowledgement")           break;
-        case 'G': DEBUG_KEYCODE(0x07, "bell")                      break;
-        case 'H': DEBUG_KEYCODE(0x08, "backspace")                 break;
-        case 'I': DEBUG_KEYCODE(0x09, "hrizontal-tab")             break;
-        case 'J': DEBUG_KEYCODE(0x0A, "line-feed")                 break;
-        case 'K': DEBUG_KEYCODE(0x0B, "vertical-tab")              break;
-        case 'L': DEBUG_KEYCODE(0x0C, "form-feed")                 break;
-        case 'M': DEBUG_KEYCODE(0x0D, "carriage-return")           break;
-        case 'N': DEBUG_KEYCODE(0x0E, "shift-out")                 break;
-        case 'O': DEBUG_KEYCODE(0x0F, "shift-in")                  break;
-        case 'P': DEBUG_KEYCODE(0x10, "data-link-escape")          break;
-        case 'Q': DEBUG_KEYCODE(0x11, "device-control-1")          break;
-        case 'R': DEBUG_KEYCODE(0x12, "device-control-2")          break;
-        case 'S': DEBUG_KEYCODE(0x13, "device-control-3")          break;
-        case 'T': DEBUG_KEYCODE(0x14, "device-control-4")          break;
-        case 'U': DEBUG_KEYCODE(0x15, "negative-acknowledgement")  break;
-        case 'V': DEBUG_KEYCODE(0x16, "synchronous-idle")          break;
-        case 'W': DEBUG_KEYCODE(0x17, "end-of-transmission-block") break;
-        case 'X': DEBUG_KEYCODE(0x18, "cancel")                    break;
-        case 'Y': DEBUG_KEYCODE(0x19, "end-of-medium")             break;
-        case 'Z': DEBUG_KEYCODE(0x1A, "substitute")                break;
-        case '[': DEBUG_KEYCODE(0x1B, "escape")                    break;
-        case '\\': DEBUG_KEYCODE(0x1C, "file-separator")           break;
-        case ']': DEBUG_KEYCODE(0x1D, "group-separator")           break;
-        case '^': DEBUG_KEYCODE(0x1E, "record-separator")          break;
-        case '_': DEBUG_KEYCODE(0x1F, "unit-separator")            break;
-        case '?': DEBUG_KEYCODE(0x7F, "delete")                    break;
-        case '2': DEBUG_KEYCODE(0x00, "null")                      break;
-        case '3': DEBUG_KEYCODE(0x1B, "escape")                    break;
-        case '4': DEBUG_KEYCODE(0x1C, "file-separator")            break;
-        case '5': DEBUG_KEYCODE(0x1D, "group-separator")           break;
-        case '6': DEBUG_KEYCODE(0x1E, "record-separator")          break;
-        case '7': DEBUG_KEYCODE(0x1F, "unit-separator")            break;
-        case '8': DEBUG_KEYCODE(0x7F, "delete")                    break;
-        }
-        break;
+      if (reply->type == connection[shared_connection::incr])
+      {
+        vt10x::log::info("clipboard; incremental paste");
 
-      default:
-        if (0x1F < code && code < 0x7F)
-        {
-          std::cerr << "; keyboard\t; ascii " << code << std::endl;
-          return true;
-        }
+        paste.begin(bracketed);
+        incoming = receiving::increments;
+        return;
       }
 
-      return false;
-    }
-  };
-} // namespace xcb
+      const std::string_view value {static_cast<const char*>(xcb_get_property_value(reply.get())), static_cast<std::size_t>(xcb_get_property_value_length(reply.get()))};
 
-namespace cairo
-{
+      if (incoming == receiving::conversion)
+      {
+        paste.begin(bracketed);
+      }
+
+      if (reply->type == XCB_ATOM_STRING) // Latin-1
+      {
+        chunk.clear();
+
+        for (const auto each : value)
+        {
+          char encoded[4];
+          char* end {encoded};
+
+          vt10x::encode_utf8(static_cast<unsigned char>(each), end);
+          chunk.append(encoded, end);
+        }
+
+        paste.append(chunk);
+      }
+      else
+      {
+        paste.append(value);
+      }
+
+      if (incoming == receiving::conversion or value.empty())
+      {
+        paste.end();
+        incoming = receiving::nothing;
+      }
+    }
+  };
+
+  template <typename Surface, auto EventMask>
+  struct machine
+    : public identity
+  {
+    vt10x::pseudo_terminal pty;
+
+    flush_policy flushing {flush_policy::iteration};
+
+    bool unflushed {false};
+
+    vt10x::frame_scheduler scheduler {};
+
+    // When the current drain began, i.e. about when its events arrived.
+    vt10x::frame_scheduler::clock::time_point drained {};
+
+    // Earliest PTY read not presented yet, if any.
+    std::optional<vt10x::frame_scheduler::clock::time_point> unpresented {};
+
+    // Owns the PTY reads in the two thread mode, see split().
+    std::optional<vt10x::parse_thread> parsing {};
+
+    // The reactor watches the PTY for writability, see rearm().
+    bool output {false};
+
+    // Held back by fold() until the end of a drain.
+    event configured {nullptr}, exposed {nullptr}, moved {nullptr};
+
+    // The grid size, which the child is told of once it has settled, see
+    // resized().
+    std::pair<std::size_t, std::size_t> geometry {vt10x::screen::default_rows, vt10x::screen::default_columns};
+
+    std::optional<vt10x::frame_scheduler::clock::time_point> settles {};
+
+    vt10x::frame_scheduler::clock::time_point told {};
+
+    static constexpr std::chrono::milliseconds settling {100};
+
+    // Pastes on their way to the child, see drip().
+    vt10x::paste paste {};
+
+    xcb::clipboard clipboard {connection, value};
+
+    // Upper bound of PTY batches consumed per wakeup, so that a child
+    // flooding output cannot keep X events waiting for more than 1 MiB.
+    static constexpr auto batch_limit {16};
+
+    enum source : std::uint64_t
+    {
+      display, pseudo_terminal
+    };
+
+    template <typename... Ts>
+    explicit machine(const vt10x::launch& how, Ts&&... operands)
+      : identity {std::forward<decltype(operands)>(operands)...}
+      , pty {name, vt10x::screen::default_rows, vt10x::screen::default_columns, how}
+    {}
+
+    void request_flush() noexcept
+    {
+      unflushed = true;
+    }
+
+    // For latency-critical requests (e.g. replies to other clients) that
+    // must not wait for the policy.
+    void flush_now()
+    {
+      vt10x::stats.flushes.fetch_add(1, std::memory_order_relaxed);
+
+      connection.flush();
+      unflushed = false;
+    }
+
+    // Flushes only if requests are pending and the policy allows flushing at
+    // this point. A frame flushes under every policy.
+    void flush_at(const flush_policy point)
+    {
+      if (unflushed and flushing <= point)
+      {
+        flush_now();
+      }
+    }
+
+    /**
+     * Moves PTY reads and parsing into terminal to a thread of their own. From
+     * then on this thread only sees the grid as snapshots, which are passed to
+     * the surface as they arrive.
+     */
+    void split(vt10x::terminal& terminal)
+    {
+      parsing.emplace(pty, terminal);
+    }
+
+    auto hung_up() const noexcept
+    {
+      return parsing ? parsing->hung_up() : pty.hung_up();
+    }
+
+    /**
+     * The grid now has this size. Every size change makes the child redraw,
+     * so during a drag it is told at once of the first and then only of the
+     * one that lasted for settling, by settle().
+     */
+    void resized(const std::size_t rows, const std::size_t columns) noexcept
+    {
+      const auto now {vt10x::frame_scheduler::clock::now()};
+
+      geometry = {rows, columns};
+      settles = told + settling <= now ? now : now + settling;
+    }
+
+    void settle(const vt10x::frame_scheduler::clock::time_point now)
+    {
+      if (settles and *settles <= now)
+      {
+        vt10x::log::info("execution; {} rows {} columns", geometry.first, geometry.second);
+
+        pty.resize(geometry.first, geometry.second);
+        settles.reset();
+        told = now;
+      }
+    }
+
+    /**
+     * Writes the next chunk of a paste once the PTY has taken the one before,
+     * then lets the clipboard fetch more of it if it was waiting for room.
+     * Until the paste is written the loop does not sleep, see timeout(); a
+     * PTY that takes no more wakes the loop when it does, see ready().
+     */
+    void drip()
+    {
+      if (const auto chunk {paste.next()}; not chunk.empty() and not pty.blocked())
+      {
+        if (not pty.write(chunk) and parsing)
+        {
+          parsing->wake();
+        }
+
+        paste.advance(chunk.size());
+        clipboard.resume(paste);
+      }
+    }
+
+    // Milliseconds until the next frame or size change is due, -1 if none, as
+    // the timeout of the reactor; 0 while a paste can be written.
+    int timeout(const vt10x::frame_scheduler::clock::time_point now) const
+    {
+      if (paste.backlog() and not pty.blocked())
+      {
+        return 0;
+      }
+
+      const auto frame {scheduler.timeout(now)};
+
+      if (not settles)
+      {
+        return frame;
+      }
+
+      const auto size {static_cast<int>(std::max<std::int64_t>(0, std::chrono::ceil<std::chrono::milliseconds>(*settles - now).count()))};
+
+      return frame < 0 ? size : std::min(frame, size);
+    }
+
+    // The descriptor that is readable when the child wrote something.
+    int descriptor() const noexcept
+    {
+      return parsing ? parsing->descriptor() : pty.descriptor();
+    }
+
+    // Selects the events Surface handles; the caller flushes.
+    void start()
+    {
+      change_attributes(XCB_CW_EVENT_MASK, selected());
+      request_flush();
+    }
+
+    // Everything read and received since the last frame is drawn at once,
+    // when the scheduler says so; until then the loop only parses.
+    void frame()
+    {
+      if (const auto now {vt10x::frame_scheduler::clock::now()}; scheduler.due(now))
+      {
+        if (static_cast<Surface&>(*this).render() and unpresented)
+        {
+          vt10x::stats.read_to_present.record(vt10x::frame_scheduler::clock::now() - *unpresented);
+          unpresented.reset();
+        }
+
+        scheduler.presented(now);
+      }
+      else if (scheduler.requested())
+      {
+        vt10x::stats.frames_deferred.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // The descriptor() is ready with epoll flags.
+    void ready(const std::uint32_t flags)
+    {
+      if (flags & EPOLLOUT)
+      {
+        pty.flush();
+      }
+
+      if (flags & ~EPOLLOUT)
+      {
+        receive();
+      }
+    }
+
+    // Input left pending by a write is retried when the PTY can take it, so
+    // the reactor watches for that only meanwhile; called before every wait,
+    // after whatever may have written.
+    void rearm(vt10x::reactor& reactor, const std::uint64_t token)
+    {
+      if (not parsing and pty.blocked() != output)
+      {
+        output = not output;
+        reactor.modify(pty.descriptor(), token, output ? EPOLLIN | EPOLLOUT : EPOLLIN);
+      }
+
+      static_cast<Surface&>(*this).found(reactor);
+    }
+
+    void execute()
+    {
+      start();
+      flush_now();
+
+      vt10x::reactor reactor {};
+
+      reactor.watch(xcb_get_file_descriptor(connection), display);
+      reactor.watch(descriptor(), pseudo_terminal);
+
+      vt10x::log::info("execution; started, {} threads", parsing ? 2 : 1);
+
+      while (not hung_up())
+      {
+        // xcb may already have queued events while waiting for some reply, so
+        // the connection is drained before sleeping, not only on readiness.
+        drain();
+
+        if (const auto error {xcb_connection_has_error(connection)}; error)
+        {
+          vt10x::log::error("execution; connection error {}", error);
+          return;
+        }
+
+        frame();
+        settle(vt10x::frame_scheduler::clock::now());
+        drip();
+
+        flush_at(flush_policy::iteration);
+
+        rearm(reactor, pseudo_terminal);
+
+        reactor.wait(timeout(vt10x::frame_scheduler::clock::now()), [&](auto source, auto flags)
+        {
+          if (source == pseudo_terminal)
+          {
+            ready(flags);
+          }
+        });
+      }
+
+      vt10x::log::info("execution; child hung up");
+    }
+
+    // Dispatches every event already received, see fold().
+    void drain()
+    {
+      drained = vt10x::frame_scheduler::clock::now();
+
+      for (event event {nullptr}; event.poll(connection); )
+      {
+        do
+        {
+          fold(event);
+        }
+        while (event.poll_queued(connection));
+      }
+
+      unfold();
+    }
+
+    /**
+     * Transfers event, except bursts of the same kind (a tiling operation
+     * produces dozens configure and expose events), which are folded so the
+     * Surface resizes and repaints once per drain instead of per event.
+     * Configures keep the last size, exposes are merged into their bounding
+     * rectangle and only the latest pointer motion survives, until unfold().
+     * Other events are transferred immediately and in order, after the
+     * configure and the motion held back, if any, so that keys and buttons
+     * meet the geometry they were pressed in and drags end where they ended.
+     */
+    void fold(event& event)
+    {
+      switch (event.type())
+      {
+      case XCB_CONFIGURE_NOTIFY:
+        configured = std::move(event);
+        break;
+
+      case XCB_MOTION_NOTIFY:
+        moved = std::move(event);
+        break;
+
+      case XCB_EXPOSE:
+        if (exposed)
+        {
+          auto* lhs {exposed.template as<xcb_expose_event_t>()};
+          const auto* rhs {event.template as<xcb_expose_event_t>()};
+
+          if (lhs->window == rhs->window)
+          {
+            const auto right  {std::max(lhs->x + lhs->width,  rhs->x + rhs->width)};
+            const auto bottom {std::max(lhs->y + lhs->height, rhs->y + rhs->height)};
+
+            lhs->x = std::min(lhs->x, rhs->x);
+            lhs->y = std::min(lhs->y, rhs->y);
+            lhs->width  = right  - lhs->x;
+            lhs->height = bottom - lhs->y;
+            lhs->count = 0;
+            break;
+          }
+
+          transfer(exposed);
+          flush_at(flush_policy::event);
+        }
+        exposed = std::move(event);
+        break;
+
+      default:
+        // What is held back happened before: a key press after a resize is
+        // meant for the new size, and a release may end the drag of a motion.
+        for (auto* pending : {&configured, &moved})
+        {
+          if (*pending)
+          {
+            transfer(*pending);
+            flush_at(flush_policy::event);
+            pending->reset();
+          }
+        }
+
+        transfer(event);
+        flush_at(flush_policy::event);
+        break;
+      }
+    }
+
+    // Transfers what fold() held back.
+    void unfold()
+    {
+      for (auto* pending : {&configured, &exposed, &moved})
+      {
+        if (*pending)
+        {
+          transfer(*pending);
+          flush_at(flush_policy::event);
+          pending->reset();
+        }
+      }
+    }
+
+    void receive()
+    {
+      if (parsing)
+      {
+        parsing->consume([&](const vt10x::snapshot& snapshot)
+        {
+          unpresented = std::min(unpresented.value_or(snapshot.read), snapshot.read);
+
+          if constexpr (std::is_invocable<Surface, const vt10x::snapshot&>::value)
+          {
+            static_cast<Surface&>(*this)(snapshot);
+          }
+        });
+
+        scheduler.request();
+        return;
+      }
+
+      for (auto batch {0}; batch < batch_limit; ++batch)
+      {
+        const auto chunk {pty.read()};
+
+        if (chunk.empty())
+        {
+          break;
+        }
+
+        vt10x::log::trace("execution; read {} bytes", chunk.size());
+
+        vt10x::stats.bytes.fetch_add(chunk.size(), std::memory_order_relaxed);
+        vt10x::stats.reads.fetch_add(1, std::memory_order_relaxed);
+
+        if (not unpresented)
+        {
+          unpresented = vt10x::frame_scheduler::clock::now();
+        }
+
+        if constexpr (std::is_invocable<Surface, std::string_view>::value)
+        {
+          static_cast<Surface&>(*this)(chunk);
+          scheduler.request();
+        }
+      }
+    }
+
+    /**
+     * Mask of the events Surface has handlers for among those EventMask
+     * allows. EventMask also tells apart event types that xcb aliases: a key
+     * press handler takes key releases too, but they are selected only if
+     * EventMask has XCB_EVENT_MASK_KEY_RELEASE.
+     *
+     * Member functions rather than static data, which would be instantiated
+     * while Surface is still incomplete.
+     */
+    static constexpr std::uint32_t selected() noexcept
+    {
+      std::uint32_t mask {0};
+
+      #define XCB_SELECT(TYPE, NAME, MASK)                                       \
+      if constexpr (std::is_invocable<                                           \
+                      Surface, const xcb_##NAME##_event_t&                       \
+                    >::value)                                                    \
+      {                                                                          \
+        mask |= (MASK);                                                          \
+      }
+
+      XCB_CORE_EVENTS(XCB_SELECT)
+
+      return mask & EventMask;
+    }
+
+    using handler = void (*)(machine&, const xcb_generic_event_t&);
+
+    template <typename T>
+    static void dispatch(machine& self, const xcb_generic_event_t& event)
+    {
+      static_cast<Surface&>(self)(reinterpret_cast<const T&>(event));
+    }
+
+    // Handler by response type, null where no event can arrive or none would
+    // be handled. Extension events, whose types the server assigns at run
+    // time, and errors go to the generic handler.
+    static constexpr std::array<handler, 128> handlers() noexcept
+    {
+      std::array<handler, 128> table {};
+
+      if constexpr (std::is_invocable<Surface, const xcb_generic_event_t&>::value)
+      {
+        table[0] = dispatch<xcb_generic_event_t>;
+
+        for (auto type {XCB_GE_GENERIC + 1}; type < static_cast<int>(table.size()); ++type)
+        {
+          table[type] = dispatch<xcb_generic_event_t>;
+        }
+      }
+
+      #define XCB_DISPATCH(TYPE, NAME, MASK)                                     \
+      if constexpr (std::is_invocable<                                           \
+                      Surface, const xcb_##NAME##_event_t&                       \
+                    >::value)                                                    \
+      {                                                                          \
+        if (not (MASK) or (MASK) & selected())                                   \
+        {                                                                        \
+          table[TYPE] = dispatch<xcb_##NAME##_event_t>;                          \
+        }                                                                        \
+      }
+
+      XCB_CORE_EVENTS(XCB_DISPATCH)
+
+      return table;
+    }
+
+    void transfer(event& event)
+    {
+      static constexpr auto table {handlers()};
+
+      vt10x::log::trace("execution; sequence {} type {}", event->sequence, event.type());
+
+      vt10x::stats.events[event.type() % vt10x::stats.events.size()].fetch_add(1, std::memory_order_relaxed);
+
+      if (const auto handle {table[event.type() % table.size()]}; handle)
+      {
+        request_flush();
+        scheduler.request();
+
+        handle(*this, *event);
+      }
+    }
+  };
+
+  template <typename Char>
+  class keyboard
+  {
+    xcb_key_symbols_t* const symbols;
+
+    Char encoded[5]; // Meta prefix and UTF-8 of a keysym outside the tables
+
+    // Fetched once per process, as there is one connection per process.
+    static xcb_key_symbols_t* shared(const shared_connection& connection)
+    {
+      static const std::unique_ptr<xcb_key_symbols_t, decltype(&xcb_key_symbols_free)> symbols {
+        xcb_key_symbols_alloc(connection), xcb_key_symbols_free
+      };
+
+      return symbols.get();
+    }
+
+  public:
+    explicit keyboard(const shared_connection& connection)
+      : symbols {shared(connection)}
+    {}
+
+    // What a few keys do in the window instead of reaching the child.
+    enum class binding
+    {
+      none,
+      page_up, page_down, // Shift+Page Up and Down, through the history
+      find,               // Control+Shift+F, a search of the history
+    };
+
+    // The keysym of a key regardless of modifiers, as bindings name keys.
+    xcb_keysym_t symbol(const xcb_key_press_event_t& event) const noexcept
+    {
+      return xcb_key_symbols_get_keysym(symbols, event.detail, 0);
+    }
+
+    binding bound(const xcb_key_press_event_t& event) const noexcept
+    {
+      const auto modifiers {event.state & (XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_1)};
+
+      switch (symbol(event))
+      {
+      case 0xFF55: return modifiers == XCB_MOD_MASK_SHIFT ? binding::page_up : binding::none;   // Prior
+      case 0xFF56: return modifiers == XCB_MOD_MASK_SHIFT ? binding::page_down : binding::none; // Next
+      case 'f':    return modifiers == (XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL) ? binding::find : binding::none;
+      default:     return binding::none;
+      }
+    }
+
+    /**
+     * Returns the bytes a key press sends to the child given the key_mode bits
+     * of the terminal, empty if none. The view is valid until the next press.
+     */
+    std::basic_string_view<Char> press(const xcb_key_press_event_t& event, const unsigned modes)
+    {
+      const auto shifted {(event.state & XCB_MOD_MASK_SHIFT) != 0};
+
+      auto code {xcb_key_symbols_get_keysym(symbols, event.detail, shifted)};
+
+      // Num Lock swaps the columns of the keypad, Caps Lock only shifts letters.
+      if (event.state & XCB_MOD_MASK_2 and xcb_is_keypad_key(xcb_key_symbols_get_keysym(symbols, event.detail, 1)))
+      {
+        code = xcb_key_symbols_get_keysym(symbols, event.detail, not shifted);
+      }
+      else if (event.state & XCB_MOD_MASK_LOCK and 'a' <= code and code <= 'z')
+      {
+        code -= 'a' - 'A';
+      }
+
+      if (xcb_is_modifier_key(code))
+      {
+        return {};
+      }
+
+      const auto modifiers {
+        (shifted ? vt10x::key_modifier::shift : 0u) |
+        (event.state & XCB_MOD_MASK_1 ? vt10x::key_modifier::meta : 0u) |
+        (event.state & XCB_MOD_MASK_CONTROL ? vt10x::key_modifier::control : 0u)
+      };
+
+      vt10x::log::trace("keyboard; keysym {} modifiers {} modes {}", code, modifiers, modes);
+
+      if (const auto bytes {vt10x::keys(code, modifiers, modes)}; not bytes.empty())
+      {
+        return bytes;
+      }
+      else if (const auto codepoint {vt10x::keysym_to_utf32(code)}; codepoint)
+      {
+        return encode(codepoint, modifiers & vt10x::key_modifier::meta);
+      }
+
+      return {};
+    }
+
+  private:
+    std::basic_string_view<Char> encode(const char32_t codepoint, const bool meta) noexcept
+    {
+      auto* end {encoded};
+
+      if (meta)
+      {
+        *end++ = '\x1B';
+      }
+
+      vt10x::encode_utf8(codepoint, end);
+
+      return {encoded, static_cast<std::size_t>(end - encoded)};
+    }
+  };
+
+  // The window an event is about, 0 for events about none or about no
+  // particular one (errors, extension events).
+  inline xcb_window_t window_of(const xcb_generic_event_t& event) noexcept
+  {
+    #define XCB_WINDOW_OF(TYPE, NAME, FIELD)                                     \
+    case TYPE:                                                                   \
+      return reinterpret_cast<const xcb_##NAME##_event_t&>(event).FIELD;
+
+    switch (event.response_type & ~0x80)
+    {
+    XCB_WINDOW_OF(XCB_KEY_PRESS,         key_press,         event)
+    XCB_WINDOW_OF(XCB_KEY_RELEASE,       key_release,       event)
+    XCB_WINDOW_OF(XCB_BUTTON_PRESS,      button_press,      event)
+    XCB_WINDOW_OF(XCB_BUTTON_RELEASE,    button_release,    event)
+    XCB_WINDOW_OF(XCB_MOTION_NOTIFY,     motion_notify,     event)
+    XCB_WINDOW_OF(XCB_ENTER_NOTIFY,      enter_notify,      event)
+    XCB_WINDOW_OF(XCB_LEAVE_NOTIFY,      leave_notify,      event)
+    XCB_WINDOW_OF(XCB_FOCUS_IN,          focus_in,          event)
+    XCB_WINDOW_OF(XCB_FOCUS_OUT,         focus_out,         event)
+    XCB_WINDOW_OF(XCB_EXPOSE,            expose,            window)
+    XCB_WINDOW_OF(XCB_VISIBILITY_NOTIFY, visibility_notify, window)
+    XCB_WINDOW_OF(XCB_DESTROY_NOTIFY,    destroy_notify,    event)
+    XCB_WINDOW_OF(XCB_UNMAP_NOTIFY,      unmap_notify,      event)
+    XCB_WINDOW_OF(XCB_MAP_NOTIFY,        map_notify,        event)
+    XCB_WINDOW_OF(XCB_REPARENT_NOTIFY,   reparent_notify,   event)
+    XCB_WINDOW_OF(XCB_CONFIGURE_NOTIFY,  configure_notify,  event)
+    XCB_WINDOW_OF(XCB_GRAVITY_NOTIFY,    gravity_notify,    event)
+    XCB_WINDOW_OF(XCB_CIRCULATE_NOTIFY,  circulate_notify,  event)
+    XCB_WINDOW_OF(XCB_PROPERTY_NOTIFY,   property_notify,   window)
+    XCB_WINDOW_OF(XCB_SELECTION_CLEAR,   selection_clear,   owner)
+    XCB_WINDOW_OF(XCB_SELECTION_REQUEST, selection_request, owner)
+    XCB_WINDOW_OF(XCB_SELECTION_NOTIFY,  selection_notify,  requestor)
+    XCB_WINDOW_OF(XCB_CLIENT_MESSAGE,    client_message,    window)
+
+    default:
+      return 0;
+    }
+  }
+
+  /**
+   * A request for a window, as a client writes it: "open\n", then the working
+   * directory and each NAME=value of the environment of the client, each
+   * ended by a NUL, and an empty string last. The window starts its child
+   * there and with that environment, as if the client had started it.
+   */
+  inline std::string make_request(const std::string_view directory, const char* const* environment)
+  {
+    std::string request {"open\n"};
+
+    request.append(directory).push_back('\0');
+
+    for (auto* each {environment}; each and *each; ++each)
+    {
+      request.append(*each).push_back('\0');
+    }
+
+    request.push_back('\0');
+
+    return request;
+  }
+
+  // The launch that request asks for, nothing while it is incomplete; throws
+  // if it is no request.
+  inline std::optional<vt10x::launch> parse_request(const std::string_view request)
+  {
+    constexpr std::string_view open {"open\n"};
+
+    if (request.substr(0, open.size()) != open.substr(0, request.size()))
+    {
+      throw std::runtime_error {"bad request"};
+    }
+
+    vt10x::launch how {{}, std::vector<std::string> {}};
+
+    for (auto offset {open.size()}, field {std::size_t {0}}; offset < request.size(); ++field)
+    {
+      const auto end {request.find('\0', offset)};
+
+      if (end == std::string_view::npos)
+      {
+        break;
+      }
+
+      const auto value {request.substr(offset, end - offset)};
+
+      if (field == 0)
+      {
+        how.directory = value;
+      }
+      else if (value.empty())
+      {
+        return how;
+      }
+      else
+      {
+        how.environment->emplace_back(value);
+      }
+
+      offset = end + 1;
+    }
+
+    return std::nullopt;
+  }
+
+  /**
+   * Runs any number of Surface windows in one process, so that they share
+   * the X connection, the key symbols and the glyph atlas, and a new window
+   * costs one Surface instead of a process start. Clients ask for windows
+   * over a UNIX socket, see request_window(); each window lives until its
+   * child hangs up. Requests are read as they arrive, like everything else,
+   * so a client slow to send one holds up no window.
+   *
+   * Every window still has its own scheduler and flush policy; this loop
+   * only routes events to them by window and waits for all of them at once.
+   */
+  template <typename Surface>
+  class server
+  {
+    vt10x::listener clients;
+
+    // Applies the command line to a new window, and maps it.
+    const std::function<void (Surface&)> prepare;
+
+    std::vector<std::unique_ptr<Surface>> windows {};
+
+    // A client whose request has not all arrived yet.
+    struct caller
+    {
+      int client;
+
+      std::string request;
+
+      vt10x::frame_scheduler::clock::time_point deadline;
+    };
+
+    std::vector<std::unique_ptr<caller>> callers {};
+
+    // For a client that connects and says nothing.
+    static constexpr std::chrono::seconds patience {5};
+
+    static constexpr std::size_t request_limit {1 << 20};
+
+    vt10x::reactor reactor {};
+
+    // Windows and callers are watched with their address as token.
+    enum source : std::uint64_t
+    {
+      display, listening
+    };
+
+  public:
+    explicit server(const std::string& path, std::function<void (Surface&)> prepare)
+      : clients {path}
+      , prepare {std::move(prepare)}
+    {}
+
+    void execute()
+    {
+      const auto& connection {identity::shared()};
+
+      reactor.watch(xcb_get_file_descriptor(connection), display);
+      reactor.watch(clients.descriptor(), listening);
+
+      vt10x::log::info("server; listening");
+
+      for (;;)
+      {
+        drain(connection);
+
+        if (const auto error {xcb_connection_has_error(connection)}; error)
+        {
+          vt10x::log::error("server; connection error {}", error);
+          return;
+        }
+
+        close_hung_up();
+        expire(vt10x::frame_scheduler::clock::now());
+
+        auto timeout {-1};
+
+        for (const auto& each : callers)
+        {
+          const auto next {static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(each->deadline - vt10x::frame_scheduler::clock::now()).count())};
+          timeout = timeout < 0 ? std::max(0, next) : std::min(timeout, std::max(0, next));
+        }
+
+        for (auto& window : windows)
+        {
+          window->frame();
+          window->settle(vt10x::frame_scheduler::clock::now());
+          window->drip();
+          window->flush_at(flush_policy::iteration);
+          window->rearm(reactor, token(*window));
+
+          if (const auto next {window->timeout(vt10x::frame_scheduler::clock::now())}; 0 <= next)
+          {
+            timeout = timeout < 0 ? next : std::min(timeout, next);
+          }
+        }
+
+        reactor.wait(timeout, [&](auto source, auto flags)
+        {
+          if (source == listening)
+          {
+            accept();
+          }
+          else if (source != display)
+          {
+            for (auto& window : windows)
+            {
+              if (token(*window) == source)
+              {
+                window->ready(flags);
+              }
+            }
+
+            for (auto& each : callers)
+            {
+              if (token(*each) == source)
+              {
+                hear(*each);
+                break;
+              }
+            }
+          }
+        });
+      }
+    }
+
+  private:
+    template <typename T>
+    static std::uint64_t token(const T& watched) noexcept
+    {
+      return reinterpret_cast<std::uintptr_t>(&watched);
+    }
+
+    void drain(const shared_connection& connection)
+    {
+      for (auto& window : windows)
+      {
+        window->drained = vt10x::frame_scheduler::clock::now();
+      }
+
+      const auto route = [&](event& event)
+      {
+        const auto id {window_of(*event)};
+
+        for (auto& window : windows)
+        {
+          if (not id)
+          {
+            window->transfer(event);
+            window->flush_at(flush_policy::event);
+          }
+          else if (window->value == id)
+          {
+            window->fold(event);
+            return;
+          }
+        }
+
+        // Property changes of windows of other clients are of selections
+        // sent to them, see clipboard; other events of a window closed
+        // meanwhile are dropped with it.
+        if (event.type() == XCB_PROPERTY_NOTIFY)
+        {
+          for (auto& window : windows)
+          {
+            window->transfer(event);
+          }
+        }
+      };
+
+      for (event event {nullptr}; event.poll(connection); )
+      {
+        do
+        {
+          route(event);
+        }
+        while (event.poll_queued(connection));
+      }
+
+      for (auto& window : windows)
+      {
+        window->unfold();
+      }
+    }
+
+    void close_hung_up()
+    {
+      const auto hung_up {std::remove_if(windows.begin(), windows.end(), [](const auto& window)
+      {
+        return window->hung_up();
+      })};
+
+      if (hung_up != windows.end())
+      {
+        windows.erase(hung_up, windows.end());
+        vt10x::log::info("server; {} windows open", windows.size());
+
+        identity::shared().flush(); // the destroyed windows
+      }
+
+      // Children that did not exit at SIGHUP right away are reaped here.
+      while (0 < waitpid(-1, nullptr, WNOHANG));
+    }
+
+    // Takes every waiting client, whose request hear() reads.
+    void accept()
+    {
+      for (auto client {clients.accept(SOCK_NONBLOCK)}; 0 <= client; client = clients.accept(SOCK_NONBLOCK))
+      {
+        try
+        {
+          auto each {std::make_unique<caller>(caller {client, {}, vt10x::frame_scheduler::clock::now() + patience})};
+
+          reactor.watch(client, token(*each));
+          callers.push_back(std::move(each));
+        }
+        catch (const std::exception& error)
+        {
+          vt10x::log::error("server; cannot take a client: {}", error.what());
+          close(client);
+        }
+      }
+    }
+
+    // Reads what the client sent so far, and answers once it has asked: one
+    // request, one window.
+    void hear(caller& each)
+    {
+      char buffer[4096];
+
+      auto ended {false};
+
+      for (;;)
+      {
+        if (const auto size {read(each.client, buffer, sizeof(buffer))}; 0 < size)
+        {
+          each.request.append(buffer, static_cast<std::size_t>(size));
+        }
+        else if (size < 0 and errno == EINTR)
+        {
+          continue;
+        }
+        else
+        {
+          ended = size == 0 or (errno != EAGAIN and errno != EWOULDBLOCK);
+          break;
+        }
+      }
+
+      std::optional<vt10x::launch> how {};
+
+      try
+      {
+        how = parse_request(each.request);
+      }
+      catch (const std::exception&)
+      {
+        return answer(each, "error bad request\n");
+      }
+
+      if (how)
+      {
+        answer(each, open(*how));
+      }
+      else if (ended or request_limit < each.request.size())
+      {
+        answer(each, "error bad request\n");
+      }
+    }
+
+    std::string open(const vt10x::launch& how)
+    {
+      try
+      {
+        auto window {std::make_unique<Surface>(how)};
+
+        prepare(*window);
+        window->start();
+        window->flush_now();
+
+        reactor.watch(window->descriptor(), token(*window));
+
+        const auto reply {"window " + std::to_string(window->value) + "\n"};
+
+        windows.push_back(std::move(window));
+        vt10x::log::info("server; {} windows open", windows.size());
+
+        return reply;
+      }
+      catch (const std::exception& error)
+      {
+        return std::string {"error "} + error.what() + "\n";
+      }
+    }
+
+    // Replies and forgets the client; closing its socket unwatches it.
+    void answer(caller& each, const std::string_view reply)
+    {
+      static_cast<void>(send(each.client, reply.data(), reply.size(), MSG_NOSIGNAL));
+      close(each.client);
+
+      callers.erase(std::find_if(callers.begin(), callers.end(), [&](const auto& other)
+      {
+        return other.get() == &each;
+      }));
+    }
+
+    // Gives up on clients past their deadline.
+    void expire(const vt10x::frame_scheduler::clock::time_point now)
+    {
+      while (true)
+      {
+        const auto late {std::find_if(callers.begin(), callers.end(), [&](const auto& each)
+        {
+          return each->deadline <= now;
+        })};
+
+        if (late == callers.end())
+        {
+          return;
+        }
+
+        answer(**late, "error no request\n");
+      }
+    }
+  };
+
+  // Asks the server at path for a window; throws if there is no server.
+  inline void request_window(const std::string& path)
+  {
+    const auto fd {vt10x::dial(path)};
+
+    if (fd < 0)
+    {
+      throw std::system_error {errno, std::generic_category(), path};
+    }
+
+    std::string directory(PATH_MAX, '\0');
+
+    if (getcwd(directory.data(), directory.size()))
+    {
+      directory.resize(std::strlen(directory.c_str()));
+    }
+    else
+    {
+      directory.clear(); // the window starts where the server is
+    }
+
+    const auto request {make_request(directory, environ)};
+
+    std::size_t written {0};
+
+    while (written < request.size())
+    {
+      if (const auto size {send(fd, request.data() + written, request.size() - written, MSG_NOSIGNAL)}; 0 <= size)
+      {
+        written += static_cast<std::size_t>(size);
+      }
+      else if (errno != EINTR)
+      {
+        break;
+      }
+    }
+
+    char reply[256] {};
+
+    const auto size {written < request.size() ? -1 : read(fd, reply, sizeof(reply) - 1)};
+
+    close(fd);
+
+    if (size <= 0 or std::string_view {reply}.compare(0, 6, "window") != 0)
+    {
+      throw std::runtime_error {size <= 0 ? "no reply from " + path : std::string {reply}};
+    }
+  }
+} // namespace xcb
+
+namespace cairo
+{
+  // Events the window may select; machine selects the subset with handlers.
   constexpr std::uint32_t event_mask
   {
     XCB_EVENT_MASK_NO_EVENT              * 1 |
     XCB_EVENT_MASK_KEY_PRESS             * 1 |
     XCB_EVENT_MASK_KEY_RELEASE           * 0 |
-    XCB_EVENT_MASK_BUTTON_PRESS          * 0 |
-    XCB_EVENT_MASK_BUTTON_RELEASE        * 0 |
+    XCB_EVENT_MASK_BUTTON_PRESS          * 1 |
+    XCB_EVENT_MASK_BUTTON_RELEASE        * 1 |
     XCB_EVENT_MASK_ENTER_WINDOW          * 0 |
     XCB_EVENT_MASK_LEAVE_WINDOW          * 0 |
     XCB_EVENT_MASK_POINTER_MOTION        * 0 |
     XCB_EVENT_MASK_POINTER_MOTION_HINT   * 0 |
-    XCB_EVENT_MASK_BUTTON_1_MOTION       * 0 |
+    XCB_EVENT_MASK_BUTTON_1_MOTION       * 1 |
     XCB_EVENT_MASK_BUTTON_2_MOTION       * 0 |
     XCB_EVENT_MASK_BUTTON_3_MOTION       * 0 |
     XCB_EVENT_MASK_BUTTON_4_MOTION       * 0 |
@@ -524,100 +1931,796 @@ namespace cairo
     XCB_EVENT_MASK_BUTTON_MOTION         * 0 |
     XCB_EVENT_MASK_KEYMAP_STATE          * 0 |
     XCB_EVENT_MASK_EXPOSURE              * 1 |
-    XCB_EVENT_MASK_VISIBILITY_CHANGE     * 0 |
+    XCB_EVENT_MASK_VISIBILITY_CHANGE     * 1 |
     XCB_EVENT_MASK_STRUCTURE_NOTIFY      * 1 |
     XCB_EVENT_MASK_RESIZE_REDIRECT       * 0 |
     XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY   * 0 |
     XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT * 0 |
-    XCB_EVENT_MASK_FOCUS_CHANGE          * 0 |
-    XCB_EVENT_MASK_PROPERTY_CHANGE       * 0 |
+    XCB_EVENT_MASK_FOCUS_CHANGE          * 1 |
+    XCB_EVENT_MASK_PROPERTY_CHANGE       * 1 |
     XCB_EVENT_MASK_COLOR_MAP_CHANGE      * 0 |
     XCB_EVENT_MASK_OWNER_GRAB_BUTTON     * 0
   };
 
-  struct surface
-    : public xcb::machine<surface, event_mask>
-    , public std::shared_ptr<cairo_surface_t>
-  {
-    explicit surface()
-      : machine<surface, event_mask> {}
-      , std::shared_ptr<cairo_surface_t> {
-          cairo_xcb_surface_create(connection, value, root_visual(connection), 1, 1),
-          cairo_surface_destroy
+  struct surface
+    : public xcb::machine<surface, event_mask>
+    , public std::shared_ptr<cairo_surface_t>
+  {
+    vt10x::terminal terminal {};
+
+    // A copy of one renderer per process, so that every window of a server
+    // draws from a single glyph atlas.
+    static const vt10x::renderer& typeface()
+    {
+      static const vt10x::renderer prototype {font};
+      return prototype;
+    }
+
+    vt10x::renderer renderer {typeface()};
+
+    // Draws go here instead of to the window when enabled.
+    std::optional<vt10x::back_buffer> back {};
+
+#ifdef VT10X_GLES
+    // Draws instead of cairo when enabled, with glyphs from renderer.
+    std::optional<vt10x::egl_window> egl {};
+
+    std::optional<vt10x::gles_renderer> gpu {};
+#endif
+
+    // What the renderer draws in the two thread mode, where terminal belongs
+    // to the parse thread.
+    vt10x::screen mirror {};
+
+    unsigned mirror_modes {0};
+
+    // The history, scrolled back through with Shift+Page Up and Down or the
+    // wheel; single threaded only, as the parse thread owns the history.
+    vt10x::viewport viewport {};
+
+    // Searches the history for the pattern typed after Control+Shift+F, as
+    // 'search PATTERN (1 of N)' in the title, until Return leaves the view
+    // at the match or Escape goes back to the screen. Up and Down go to the
+    // older and the newer match.
+    std::optional<vt10x::search> finder {};
+
+    std::optional<std::string> pattern {};
+
+    std::vector<vt10x::search::match> matches {}; // newest first
+
+    std::optional<std::size_t> current {}; // of matches, shown
+
+    bool hunting {false}, watching {false}; // found() takes matches; the loop wakes for them
+
+    xcb::keyboard<char> keyboard {connection};
+
+    // Where a drag of button 1 began, while it goes on, and what it selected.
+    std::optional<vt10x::selection::point> anchor {};
+
+    std::optional<vt10x::selection::region> selected {};
+
+    // Frames are drawn only while the window is mapped and not covered up.
+    bool mapped {false}, obscured {false};
+
+    explicit surface(const vt10x::launch& how = {})
+      : machine<surface, event_mask> {how}
+      , std::shared_ptr<cairo_surface_t> {
+          cairo_xcb_surface_create(connection, value, root_visual(connection), 1, 1),
+          cairo_surface_destroy
+        }
+    {
+      vt10x::log::info("surface; instantiated window {}", value);
+    }
+
+    ~surface()
+    {
+      parsing.reset(); // before terminal goes away
+
+#ifdef VT10X_GLES
+      if (egl)
+      {
+        egl->current(); // of which gpu deletes its objects
+      }
+#endif
+    }
+
+    // explicit surface(const surface& parent)
+    //   : machine<surface, event_mask> {parent.value}
+    //   , std::shared_ptr<cairo_surface_t> {cairo_xcb_surface_create(
+    //       connection, value, root_visual(connection), 1, 1
+    //     ), cairo_surface_destroy}
+    // {}
+
+    operator cairo_surface_t*() const noexcept
+    {
+      return get();
+    }
+
+    decltype(auto) flush()
+    {
+      cairo_surface_flush(*this);
+
+      vt10x::log::debug("surface; flushed");
+
+      request_flush();
+      flush_at(xcb::flush_policy::frame);
+    }
+
+    // Fits the grid to the window, in whole cells; the grid changes only when
+    // the count of cells does.
+    void size(const std::uint32_t width, const std::uint32_t height)
+    {
+      if (back and back->resize(width, height))
+      {
+        renderer.invalidate();
+      }
+
+      cairo_xcb_surface_set_size(*this, width, height);
+
+#ifdef VT10X_GLES
+      if (gpu)
+      {
+        gpu->resize(width, height);
+      }
+#endif
+
+      const auto rows {std::max<std::size_t>(1, static_cast<std::size_t>(height / renderer.cell_height))};
+      const auto columns {std::max<std::size_t>(1, static_cast<std::size_t>(width / renderer.cell_width))};
+
+      if (std::pair {rows, columns} != geometry)
+      {
+        if (parsing)
+        {
+          parsing->resize(rows, columns);
+        }
+        else
+        {
+          terminal.resize(rows, columns);
+        }
+
+        resized(rows, columns);
+      }
+    }
+
+    void split()
+    {
+      machine::split(terminal);
+    }
+
+    // The grid as this thread is allowed to see it, or the history on it.
+    vt10x::screen& displayed() noexcept
+    {
+      return parsing ? mirror : viewport.scrolled() ? viewport.view : terminal.screen;
+    }
+
+    // Scrolls through the history of the primary screen by rows, back if
+    // negative. A selection is of what was shown, so it is unmarked.
+    void scroll(const long rows)
+    {
+      if (not parsing and not terminal.alternative and viewport.scroll(rows, terminal.screen, terminal.history))
+      {
+        mark(std::nullopt);
+      }
+    }
+
+    // A key pressed while the pattern of a search is typed.
+    void type(const xcb_key_press_event_t& event)
+    {
+      switch (keyboard.symbol(event))
+      {
+      case 0xFF1B: // Escape
+        viewport.reset(terminal.screen);
+        mark(std::nullopt);
+        [[fallthrough]];
+
+      case 0xFF0D: // Return
+        pattern.reset();
+        title("vt10x");
+        return;
+
+      case 0xFF08: // BackSpace, of a whole character
+        while (not pattern->empty() and (pattern->back() & 0xC0) == 0x80)
+        {
+          pattern->pop_back();
+        }
+
+        if (not pattern->empty())
+        {
+          pattern->pop_back();
+        }
+
+        return seek();
+
+      case 0xFF52: // Up
+        return go(current ? *current + 1 : 0);
+
+      case 0xFF54: // Down
+        return go(current and *current ? *current - 1 : matches.size());
+
+      default:
+        break;
+      }
+
+      if (event.state & (XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_1))
+      {
+        return;
+      }
+
+      if (const auto bytes {keyboard.press(event, 0)}; not bytes.empty() and std::none_of(bytes.begin(), bytes.end(), [](const unsigned char each) { return each < 0x20 or each == 0x7F; }))
+      {
+        pattern->append(bytes);
+        seek();
+      }
+    }
+
+    // Searches anew for the pattern as it is now.
+    void seek()
+    {
+      if (not finder)
+      {
+        finder.emplace(terminal.history);
+      }
+
+      matches.clear();
+      current.reset();
+
+      finder->find(*pattern);
+      hunting = true;
+
+      retitle();
+    }
+
+    // Shows match index, if there is one.
+    void go(const std::size_t index)
+    {
+      if (index < matches.size())
+      {
+        const auto& match {matches[index]};
+
+        if (const auto region {viewport.reveal(match.line, match.offset, match.length, terminal.screen, terminal.history)}; region)
+        {
+          current = index;
+          mark(region);
+        }
+      }
+
+      retitle();
+    }
+
+    void retitle()
+    {
+      if (not pattern)
+      {
+        return;
+      }
+
+      auto text {"search " + *pattern};
+
+      if (current)
+      {
+        text += " (" + std::to_string(*current + 1) + " of " + std::to_string(matches.size()) + (hunting ? "+)" : ")");
+      }
+      else if (not hunting and not pattern->empty())
+      {
+        text += " (not found)";
+      }
+
+      title(text);
+      request_flush();
+    }
+
+    // Takes the matches of a search found since the last time, before every
+    // wait of the loop, which the search wakes as the display does: to go
+    // round once more.
+    void found(vt10x::reactor& reactor)
+    {
+      if (not finder or not hunting)
+      {
+        return;
+      }
+
+      if (not watching)
+      {
+        reactor.watch(finder->descriptor(), display); // 0, the display of a server too
+        watching = true;
+      }
+
+      const auto before {matches.size()};
+
+      hunting = not finder->consume([&](const auto& batch)
+      {
+        matches.insert(matches.end(), batch.begin(), batch.end());
+      });
+
+      if (hunting and before == matches.size())
+      {
+        return;
+      }
+
+      if (not current and before < matches.size())
+      {
+        go(0);
+      }
+      else
+      {
+        retitle();
+      }
+
+      scheduler.request();
+      flush_now();
+    }
+
+    // The key_mode bits of the terminal as this thread is allowed to see them.
+    unsigned modes() const noexcept
+    {
+      return parsing ? mirror_modes : terminal.modes();
+    }
+
+    // The cell under a point of the window, the nearest one outside the grid.
+    vt10x::selection::point cell_at(const std::int16_t x, const std::int16_t y) noexcept
+    {
+      const auto& screen {displayed()};
+
+      return {
+        std::min(screen.rows() - 1, static_cast<std::size_t>(std::max(0, static_cast<int>(y)) / renderer.cell_height)),
+        std::min(screen.columns() - 1, static_cast<std::size_t>(std::max(0, static_cast<int>(x)) / renderer.cell_width)),
+      };
+    }
+
+    void mark(const std::optional<vt10x::selection::region>& region)
+    {
+      selected = region;
+      renderer.mark(displayed(), region);
+    }
+
+    // Suspends the frames while the window cannot be seen; its first frame
+    // once it can again is drawn whole, as for a new window.
+    void shown()
+    {
+      const auto visible {mapped and not obscured};
+
+      scheduler.suspend(not visible);
+
+      if (visible)
+      {
+        renderer.invalidate();
+        displayed().damage_all();
+        unpresented.reset(); // time hidden is no latency
+      }
+    }
+
+    void buffer(const bool shm)
+    {
+      back.emplace(connection, value, connection.screen->root_depth, shm);
+    }
+
+#ifdef VT10X_GLES
+    // Draws with OpenGL ES from now on, with a config for the screen of the
+    // window.
+    void accelerate()
+    {
+      egl.emplace(connection, connection.number, value);
+      gpu.emplace(renderer);
+    }
+#endif
+
+    // Redraws what was damaged since the last call, if anything; true if a
+    // frame went out.
+    bool render()
+    {
+      // The alternate screen has no history to be scrolled back over.
+      if (not parsing and terminal.alternative)
+      {
+        viewport.reset(terminal.screen);
+      }
+      else if (not parsing)
+      {
+        viewport.compose(terminal.screen, terminal.history);
+      }
+
+#ifdef VT10X_GLES
+      if (gpu)
+      {
+        egl->current();
+
+        if (not gpu->render(displayed()))
+        {
+          vt10x::stats.frames_empty.fetch_add(1, std::memory_order_relaxed);
+          return false;
         }
+
+        egl->present();
+        request_flush();
+        flush_at(xcb::flush_policy::frame);
+
+        vt10x::stats.frames_rendered.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+#endif
+
+      if (back and (back->busy() or not back->surface()))
+      {
+        vt10x::stats.frames_busy.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      const auto box {renderer.render(back ? back->surface() : static_cast<cairo_surface_t*>(*this), displayed())};
+
+      if (box.empty())
+      {
+        vt10x::stats.frames_empty.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      if (back)
+      {
+        back->present(box.x, box.y, box.width, box.height);
+        request_flush();
+        flush_at(xcb::flush_policy::frame);
+      }
+      else
+      {
+        flush();
+      }
+
+      vt10x::stats.frames_rendered.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Sends bytes to the child, after any paste. Input the PTY cannot take
+    // now is written by whichever thread watches it, once it becomes writable.
+    void input(const std::string_view bytes)
     {
-      std::cerr << "; surface\t; instatiated" << std::endl;
+      if (not paste.type(bytes) and not pty.write(bytes) and parsing)
+      {
+        parsing->wake();
+      }
     }
 
-    // explicit surface(const surface& parent)
-    //   : machine<surface, event_mask> {parent.value}
-    //   , std::shared_ptr<cairo_surface_t> {cairo_xcb_surface_create(
-    //       connection, value, root_visual(connection), 1, 1
-    //     ), cairo_surface_destroy}
-    // {}
+    void operator()(const std::string_view chunk)
+    {
+      terminal.feed(chunk);
+      scheduler.hold(terminal.synchronized, vt10x::frame_scheduler::clock::now());
 
-    operator cairo_surface_t*() const noexcept
+      if (not terminal.response.empty())
+      {
+        input(terminal.response);
+        terminal.response.clear();
+      }
+    }
+
+    void operator()(const vt10x::snapshot& snapshot)
     {
-      return get();
+      snapshot.apply(mirror);
+      mirror_modes = snapshot.modes;
+      scheduler.hold(snapshot.synchronized, vt10x::frame_scheduler::clock::now());
     }
 
-    decltype(auto) flush()
+    // The back buffer still holds what was exposed, so it is only copied.
+    void operator()(const xcb_expose_event_t& event)
     {
-      cairo_surface_flush(*this);
-      std::cerr << "; surface\t; flushed" << std::endl;
-      connection.flush();
+      if (back and back->surface())
+      {
+        back->present(event.x, event.y, event.width, event.height);
+      }
+      else
+      {
+        renderer.expose(displayed(), event.x, event.y, event.width, event.height);
+      }
+    }
+
+    void operator()(const xcb_generic_event_t& event)
+    {
+      if (back)
+      {
+        back->complete(&event);
+      }
+    }
+
+    // Typing goes back to the screen from the history, as in urxvt.
+    void operator()(const xcb_key_press_event_t& event)
+    {
+      using binding = decltype(keyboard)::binding;
+
+      const auto bound {parsing or terminal.alternative ? binding::none : keyboard.bound(event)};
+
+      if (bound == binding::page_up or bound == binding::page_down)
+      {
+        scroll((bound == binding::page_up ? -1 : 1) * static_cast<long>(std::max<std::size_t>(1, terminal.screen.rows() - 1)));
+      }
+      else if (pattern)
+      {
+        type(event);
+      }
+      else if (bound == binding::find)
+      {
+        pattern.emplace();
+        seek();
+      }
+      else if (const auto bytes {keyboard.press(event, modes())}; not bytes.empty())
+      {
+        if (viewport.scrolled())
+        {
+          viewport.reset(terminal.screen);
+          mark(std::nullopt);
+        }
+
+        input(bytes);
+        vt10x::stats.key_to_write.record(vt10x::frame_scheduler::clock::now() - drained);
+      }
+    }
+
+    void operator()(const xcb_configure_notify_event_t& event)
+    {
+      size(event.width, event.height);
+    }
+
+    void operator()(const xcb_map_notify_event_t&)
+    {
+      mapped = true;
+      shown();
+    }
+
+    void operator()(const xcb_unmap_notify_event_t&)
+    {
+      mapped = false;
+      shown();
+    }
+
+    void operator()(const xcb_visibility_notify_event_t& event)
+    {
+      if (obscured != (event.state == XCB_VISIBILITY_FULLY_OBSCURED))
+      {
+        obscured = not obscured;
+        shown();
+      }
+    }
+
+    // Focus outs too, of the same type. The pointer moving into the window
+    // of a focus that is elsewhere changes nothing.
+    void operator()(const xcb_focus_in_event_t& event)
+    {
+      if (event.detail != XCB_NOTIFY_DETAIL_POINTER)
+      {
+        scheduler.throttle((event.response_type & ~0x80) == XCB_FOCUS_OUT);
+      }
+    }
+
+    // Button 1 selects what it is dragged over, button 2 pastes PRIMARY and
+    // the wheel scrolls the history; as for keys, the handler of presses
+    // takes releases too.
+    void operator()(const xcb_button_press_event_t& event)
+    {
+      const auto released {(event.response_type & ~0x80) == XCB_BUTTON_RELEASE};
+
+      if (event.detail == XCB_BUTTON_INDEX_1 and not released)
+      {
+        anchor = cell_at(event.event_x, event.event_y);
+        mark(std::nullopt);
+      }
+      else if (event.detail == XCB_BUTTON_INDEX_1 and anchor)
+      {
+        mark(vt10x::selection::region::released(*anchor, cell_at(event.event_x, event.event_y), selected.has_value()));
+
+        if (selected)
+        {
+          clipboard.own(std::make_shared<const vt10x::selection>(displayed(), *selected), event.time);
+        }
+
+        anchor.reset();
+      }
+      else if (event.detail == XCB_BUTTON_INDEX_2 and not released)
+      {
+        clipboard.request(event.time, modes() & vt10x::key_mode::bracketed_paste);
+      }
+      else if ((event.detail == XCB_BUTTON_INDEX_4 or event.detail == XCB_BUTTON_INDEX_5) and not released)
+      {
+        scroll(event.detail == XCB_BUTTON_INDEX_4 ? -3 : 3);
+      }
+    }
+
+    void operator()(const xcb_motion_notify_event_t& event)
+    {
+      if (anchor)
+      {
+        mark(vt10x::selection::region::between(*anchor, cell_at(event.event_x, event.event_y)));
+      }
+    }
+
+    void operator()(const xcb_selection_clear_event_t& event)
+    {
+      clipboard(event);
+      mark(std::nullopt);
     }
 
-    decltype(auto) size(const std::uint32_t width, const std::uint32_t height) const noexcept
+    // Replies to other clients, which wait for them.
+    void operator()(const xcb_selection_request_event_t& event)
     {
-      return cairo_xcb_surface_set_size(*this, width, height);
+      clipboard(event);
+      flush_now();
     }
 
-    // void operator()(const std::unique_ptr<xcb_expose_event_t> event)
-    // {
-    // }
+    void operator()(const xcb_selection_notify_event_t& event)
+    {
+      clipboard(event, paste);
+    }
 
-    void operator()(std::unique_ptr<xcb_key_press_event_t>&& event)
+    void operator()(const xcb_property_notify_event_t& event)
     {
-      static xcb::keyboard<char> keyboard {connection};
-      keyboard.press(std::move(event));
+      clipboard(event, paste);
+
+      if (event.state == XCB_PROPERTY_DELETE)
+      {
+        flush_now();
+      }
     }
 
-    void operator()(const std::unique_ptr<xcb_configure_notify_event_t> event)
+    // The window manager's close button: the child hangs up as it would when
+    // its terminal goes away, and the window closes once it has.
+    void operator()(const xcb_client_message_event_t& event)
     {
-      size(event->width, event->height);
+      if (event.type == connection[xcb::shared_connection::wm_protocols] and event.data.data32[0] == connection[xcb::shared_connection::wm_delete_window])
+      {
+        pty.hang_up();
+      }
     }
   };
 } // namespace cairo
 
-// struct cursor
-// {
-//   std::size_t row, column;
-// };
-//
-// struct screen
-// {
-// };
+// Where a server for this display listens unless told otherwise.
+std::string default_socket()
+{
+  const auto* const runtime {std::getenv("XDG_RUNTIME_DIR")};
+  const auto* const display {std::getenv("DISPLAY")};
 
-std::size_t row {24}, column {80};
+  auto path {runtime and *runtime ? std::string {runtime} + "/vt10x" : "/tmp/vt10x-" + std::to_string(getuid())};
 
-const auto* font {"Monospace:pixelsize=14:antialias=true:autohint=true"};
-const auto* name {"vt10x-256color"};
+  if (display)
+  {
+    path += '-';
+    path += display;
+    std::replace(path.end() - std::strlen(display), path.end(), '/', '_');
+  }
+
+  return path + ".sock";
+}
 
 int main(const int argc, char const* const* const argv)
 {
   const std::vector<std::string> args {argv + 1, argv + argc};
 
-  cairo::surface main {};
+  vt10x::log::install_handlers();
 
-  main.configure(XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, 1280u, 720u);
-  main.size(1280, 720);
+  // Before the parse and stats threads exist, which inherit the mask.
+  vt10x::stats_reporter::block();
 
-  main.map();
-  main.flush();
+  std::optional<vt10x::log::drainer> logging {};
+
+  std::string stats_path {};
+
+  std::optional<std::string> serving {}, requesting {};
+
+  vt10x::scrollback::limits history {};
+
+  for (const auto& each : args)
+  {
+    if (each.compare(0, 6, "--log=") == 0)
+    {
+      const auto fd {each == "--log=-" ? STDERR_FILENO : open(each.c_str() + 6, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)};
+
+      if (fd < 0)
+      {
+        throw std::system_error {errno, std::generic_category(), "open"};
+      }
+
+      logging.emplace(fd);
+    }
+    else if (each.compare(0, 8, "--stats=") == 0)
+    {
+      stats_path = each.substr(8);
+    }
+    else if (each == "--server" or each.compare(0, 9, "--server=") == 0)
+    {
+      serving = each.size() < 9 ? default_socket() : each.substr(9);
+    }
+    else if (each == "--client" or each.compare(0, 9, "--client=") == 0)
+    {
+      requesting = each.size() < 9 ? default_socket() : each.substr(9);
+    }
+    else if (each.compare(0, 10, "--history=") == 0)
+    {
+      history.lines = std::stoul(each.substr(10));
+    }
+    else if (each.compare(0, 17, "--history-memory=") == 0)
+    {
+      history.memory = std::stoul(each.substr(17)) << 20;
+    }
+    else if (each.compare(0, 16, "--history-spill=") == 0)
+    {
+      history.spill = each.substr(16);
+    }
+  }
+
+  // Nothing but the request: the server owns the display connection.
+  if (requesting)
+  {
+    xcb::request_window(*requesting);
+    return 0;
+  }
+
+  // Options of a window, the only one or each one a server opens.
+  const auto prepare = [&](cairo::surface& window)
+  {
+    window.terminal.history.configure(history); // before --threads=2 hands it over
+
+    for (const auto& each : args)
+    {
+      if (each.compare(0, 9, "--record=") == 0) // likewise, and one file per window of a server
+      {
+        window.pty.record(std::make_unique<vt10x::recorder>(serving ? each.substr(9) + "." + std::to_string(window.value) : each.substr(9)));
+      }
+    }
+
+    for (const auto& each : args)
+    {
+      if (each == "--flush=event")
+      {
+        window.flushing = xcb::flush_policy::event;
+      }
+      else if (each == "--flush=iteration")
+      {
+        window.flushing = xcb::flush_policy::iteration;
+      }
+      else if (each == "--flush=frame")
+      {
+        window.flushing = xcb::flush_policy::frame;
+      }
+      else if (each.compare(0, 6, "--fps=") == 0)
+      {
+        window.scheduler.cap(std::stoul(each.substr(6)));
+      }
+      else if (each == "--threads=2")
+      {
+        window.split();
+      }
+      else if (each == "--buffer=shm")
+      {
+        window.buffer(true);
+      }
+      else if (each == "--buffer=image")
+      {
+        window.buffer(false);
+      }
+#ifdef VT10X_GLES
+      else if (each == "--render=gles")
+      {
+        window.accelerate();
+      }
+#endif
+    }
+
+    window.configure(XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, 1280u, 720u);
+    window.size(1280, 720);
+
+    window.title("vt10x");
+    window.map();
+    window.flush();
+  };
+
+  // Writes the statistics on SIGUSR1, and to clients of --stats=PATH.
+  const vt10x::stats_reporter reporting {stats_path};
+
+  if (serving)
+  {
+    xcb::server<cairo::surface> {*serving, prepare}.execute();
+    return 0;
+  }
+
+  cairo::surface main {};
+
+  prepare(main);
 
   main.execute();
 
   return 0;
 }
-